@@ -0,0 +1,1066 @@
+// Copyright (C) 2017 Elviss Strazdins
+
+#include <algorithm>
+#include <cstring>
+#include "SpineAnimationLoader.hpp"
+#include "spine/spine.h"
+#include "spine/extension.h"
+
+// constants of the spine 3.6 binary format
+static const uint8_t ATTACHMENT_REGION = 0;
+static const uint8_t ATTACHMENT_BOUNDING_BOX = 1;
+static const uint8_t ATTACHMENT_MESH = 2;
+static const uint8_t ATTACHMENT_LINKED_MESH = 3;
+static const uint8_t ATTACHMENT_PATH = 4;
+static const uint8_t ATTACHMENT_POINT = 5;
+static const uint8_t ATTACHMENT_CLIPPING = 6;
+
+static const uint8_t SLOT_ATTACHMENT = 0;
+static const uint8_t SLOT_COLOR = 1;
+static const uint8_t SLOT_TWO_COLOR = 2;
+
+static const uint8_t BONE_ROTATE = 0;
+static const uint8_t BONE_TRANSLATE = 1;
+static const uint8_t BONE_SCALE = 2;
+static const uint8_t BONE_SHEAR = 3;
+
+static const int8_t PATH_POSITION = 0;
+static const int8_t PATH_SPACING = 1;
+static const int8_t PATH_MIX = 2;
+
+static const uint8_t CURVE_STEPPED = 1;
+static const uint8_t CURVE_BEZIER = 2;
+
+// big endian reader like the one in spine-c's SkeletonBinary.c, reading past the end sets the error flag instead
+class BinaryInput
+{
+public:
+    BinaryInput(const uint8_t* initBegin, const uint8_t* initEnd):
+        begin(initBegin), cursor(initBegin), end(initEnd)
+    {
+    }
+
+    uint8_t readByte()
+    {
+        if (cursor >= end)
+        {
+            error = true;
+            return 0;
+        }
+
+        return *cursor++;
+    }
+
+    int8_t readSByte() { return static_cast<int8_t>(readByte()); }
+    bool readBoolean() { return readByte() != 0; }
+
+    int32_t readInt()
+    {
+        uint32_t result = static_cast<uint32_t>(readByte()) << 24;
+        result |= static_cast<uint32_t>(readByte()) << 16;
+        result |= static_cast<uint32_t>(readByte()) << 8;
+        result |= static_cast<uint32_t>(readByte());
+        return static_cast<int32_t>(result);
+    }
+
+    float readFloat()
+    {
+        int32_t bits = readInt();
+        float result;
+        memcpy(&result, &bits, sizeof(result));
+        return result;
+    }
+
+    int32_t readVarint(bool optimizePositive)
+    {
+        uint32_t result = 0;
+
+        for (uint32_t shift = 0; shift <= 28; shift += 7)
+        {
+            uint8_t b = readByte();
+            result |= static_cast<uint32_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) break;
+        }
+
+        if (!optimizePositive) result = (result >> 1) ^ (~(result & 1) + 1);
+
+        return static_cast<int32_t>(result);
+    }
+
+    // returns false for null strings
+    bool readString(std::string& result)
+    {
+        int32_t length = readVarint(true);
+        if (length <= 0) return false;
+
+        size_t size = static_cast<size_t>(length - 1);
+        if (!require(size)) return false;
+
+        result.assign(reinterpret_cast<const char*>(cursor), size);
+        cursor += size;
+        return true;
+    }
+
+    void skip(size_t size)
+    {
+        if (require(size)) cursor += size;
+    }
+
+    void skipString()
+    {
+        int32_t length = readVarint(true);
+        if (length > 0) skip(static_cast<size_t>(length - 1));
+    }
+
+    void skipFloats(int32_t count)
+    {
+        if (count < 0) setError();
+        else skip(static_cast<size_t>(count) * 4);
+    }
+
+    void setError()
+    {
+        error = true;
+        cursor = end;
+    }
+
+    size_t getOffset() const { return static_cast<size_t>(cursor - begin); }
+    bool isEnd() const { return cursor == end; }
+    bool hasError() const { return error; }
+
+private:
+    bool require(size_t size)
+    {
+        if (static_cast<size_t>(end - cursor) < size)
+        {
+            setError();
+            return false;
+        }
+
+        return true;
+    }
+
+    const uint8_t* begin;
+    const uint8_t* cursor;
+    const uint8_t* end;
+    bool error = false;
+};
+
+static void skipVertices(BinaryInput& input, int32_t vertexCount)
+{
+    if (!input.readBoolean())
+    {
+        input.skipFloats(vertexCount * 2);
+        return;
+    }
+
+    for (int32_t v = 0; v < vertexCount && !input.hasError(); ++v)
+    {
+        int32_t boneCount = input.readVarint(true);
+
+        for (int32_t b = 0; b < boneCount && !input.hasError(); ++b)
+        {
+            input.readVarint(true);
+            input.skipFloats(3);
+        }
+    }
+}
+
+static void skipAttachment(BinaryInput& input, bool nonessential)
+{
+    input.skipString();
+
+    switch (input.readByte())
+    {
+        case ATTACHMENT_REGION:
+            input.skipString();
+            input.skipFloats(7);
+            input.readInt();
+            break;
+        case ATTACHMENT_BOUNDING_BOX:
+            skipVertices(input, input.readVarint(true));
+            if (nonessential) input.readInt();
+            break;
+        case ATTACHMENT_MESH:
+        {
+            input.skipString();
+            input.readInt();
+            int32_t vertexCount = input.readVarint(true);
+            input.skipFloats(vertexCount * 2);
+            input.skip(static_cast<size_t>(input.readVarint(true)) * 2);
+            skipVertices(input, vertexCount);
+            input.readVarint(true);
+            if (nonessential)
+            {
+                input.skip(static_cast<size_t>(input.readVarint(true)) * 2);
+                input.skipFloats(2);
+            }
+            break;
+        }
+        case ATTACHMENT_LINKED_MESH:
+            input.skipString();
+            input.readInt();
+            input.skipString();
+            input.skipString();
+            input.readBoolean();
+            if (nonessential) input.skipFloats(2);
+            break;
+        case ATTACHMENT_PATH:
+        {
+            input.readBoolean();
+            input.readBoolean();
+            int32_t vertexCount = input.readVarint(true);
+            skipVertices(input, vertexCount);
+            input.skipFloats(vertexCount / 3);
+            if (nonessential) input.readInt();
+            break;
+        }
+        case ATTACHMENT_POINT:
+            input.skipFloats(3);
+            if (nonessential) input.readInt();
+            break;
+        case ATTACHMENT_CLIPPING:
+            input.readVarint(true);
+            skipVertices(input, input.readVarint(true));
+            if (nonessential) input.readInt();
+            break;
+        default:
+            input.setError();
+            break;
+    }
+}
+
+static void skipSkin(BinaryInput& input, bool nonessential)
+{
+    int32_t slotCount = input.readVarint(true);
+
+    for (int32_t s = 0; s < slotCount && !input.hasError(); ++s)
+    {
+        input.readVarint(true);
+        int32_t attachmentCount = input.readVarint(true);
+
+        for (int32_t a = 0; a < attachmentCount && !input.hasError(); ++a)
+        {
+            input.skipString();
+            skipAttachment(input, nonessential);
+        }
+    }
+}
+
+static void skipCurve(BinaryInput& input)
+{
+    if (input.readByte() == CURVE_BEZIER) input.skipFloats(4);
+}
+
+static void skipCurveFrames(BinaryInput& input, int32_t frameCount, int32_t valueCount)
+{
+    for (int32_t frame = 0; frame < frameCount && !input.hasError(); ++frame)
+    {
+        input.skipFloats(1 + valueCount);
+        if (frame < frameCount - 1) skipCurve(input);
+    }
+}
+
+static void skipAnimation(BinaryInput& input)
+{
+    // slot timelines
+    for (int32_t i = 0, n = input.readVarint(true); i < n && !input.hasError(); ++i)
+    {
+        input.readVarint(true);
+
+        for (int32_t t = 0, timelineCount = input.readVarint(true); t < timelineCount && !input.hasError(); ++t)
+        {
+            uint8_t timelineType = input.readByte();
+            int32_t frameCount = input.readVarint(true);
+
+            for (int32_t frame = 0; frame < frameCount && !input.hasError(); ++frame)
+            {
+                input.skipFloats(1);
+
+                if (timelineType == SLOT_ATTACHMENT)
+                {
+                    input.skipString();
+                    continue;
+                }
+
+                input.readInt();
+                if (timelineType == SLOT_TWO_COLOR) input.readInt();
+                if (frame < frameCount - 1) skipCurve(input);
+            }
+        }
+    }
+
+    // bone timelines
+    for (int32_t i = 0, n = input.readVarint(true); i < n && !input.hasError(); ++i)
+    {
+        input.readVarint(true);
+
+        for (int32_t t = 0, timelineCount = input.readVarint(true); t < timelineCount && !input.hasError(); ++t)
+        {
+            uint8_t timelineType = input.readByte();
+            skipCurveFrames(input, input.readVarint(true), (timelineType == BONE_ROTATE) ? 1 : 2);
+        }
+    }
+
+    // IK constraint timelines
+    for (int32_t i = 0, n = input.readVarint(true); i < n && !input.hasError(); ++i)
+    {
+        input.readVarint(true);
+        int32_t frameCount = input.readVarint(true);
+
+        for (int32_t frame = 0; frame < frameCount && !input.hasError(); ++frame)
+        {
+            input.skipFloats(2);
+            input.readSByte();
+            if (frame < frameCount - 1) skipCurve(input);
+        }
+    }
+
+    // transform constraint timelines
+    for (int32_t i = 0, n = input.readVarint(true); i < n && !input.hasError(); ++i)
+    {
+        input.readVarint(true);
+        skipCurveFrames(input, input.readVarint(true), 4);
+    }
+
+    // path constraint timelines
+    for (int32_t i = 0, n = input.readVarint(true); i < n && !input.hasError(); ++i)
+    {
+        input.readVarint(true);
+
+        for (int32_t t = 0, timelineCount = input.readVarint(true); t < timelineCount && !input.hasError(); ++t)
+        {
+            int8_t timelineType = input.readSByte();
+            skipCurveFrames(input, input.readVarint(true), (timelineType == PATH_MIX) ? 2 : 1);
+        }
+    }
+
+    // deform timelines
+    for (int32_t i = 0, n = input.readVarint(true); i < n && !input.hasError(); ++i)
+    {
+        input.readVarint(true);
+
+        for (int32_t s = 0, slotCount = input.readVarint(true); s < slotCount && !input.hasError(); ++s)
+        {
+            input.readVarint(true);
+
+            for (int32_t a = 0, attachmentCount = input.readVarint(true); a < attachmentCount && !input.hasError(); ++a)
+            {
+                input.skipString();
+                int32_t frameCount = input.readVarint(true);
+
+                for (int32_t frame = 0; frame < frameCount && !input.hasError(); ++frame)
+                {
+                    input.skipFloats(1);
+
+                    if (int32_t end = input.readVarint(true))
+                    {
+                        input.readVarint(true);
+                        input.skipFloats(end);
+                    }
+
+                    if (frame < frameCount - 1) skipCurve(input);
+                }
+            }
+        }
+    }
+
+    // draw order timeline
+    for (int32_t i = 0, n = input.readVarint(true); i < n && !input.hasError(); ++i)
+    {
+        input.skipFloats(1);
+
+        for (int32_t o = 0, offsetCount = input.readVarint(true); o < offsetCount && !input.hasError(); ++o)
+        {
+            input.readVarint(true);
+            input.readVarint(true);
+        }
+    }
+
+    // event timeline
+    for (int32_t i = 0, n = input.readVarint(true); i < n && !input.hasError(); ++i)
+    {
+        input.skipFloats(1);
+        input.readVarint(true);
+        input.readVarint(false);
+        input.skipFloats(1);
+        if (input.readBoolean()) input.skipString();
+    }
+}
+
+static void readCurve(BinaryInput& input, spCurveTimeline* timeline, int frame)
+{
+    switch (input.readByte())
+    {
+        case CURVE_STEPPED:
+            spCurveTimeline_setStepped(timeline, frame);
+            break;
+        case CURVE_BEZIER:
+        {
+            float cx1 = input.readFloat();
+            float cy1 = input.readFloat();
+            float cx2 = input.readFloat();
+            float cy2 = input.readFloat();
+            spCurveTimeline_setCurve(timeline, frame, cx1, cy1, cx2, cy2);
+            break;
+        }
+    }
+}
+
+// reads keyframes made of a time and valueCount floats followed by a curve, returns the time of the last keyframe
+template<class Timeline, class SetFrame>
+static float readCurveFrames(BinaryInput& input, Timeline* timeline, int frameCount, int valueCount, const SetFrame& setFrame)
+{
+    float time = 0.0f;
+    float values[4];
+
+    for (int frame = 0; frame < frameCount; ++frame)
+    {
+        time = input.readFloat();
+        for (int v = 0; v < valueCount; ++v) values[v] = input.readFloat();
+
+        setFrame(timeline, frame, time, values);
+
+        if (frame < frameCount - 1) readCurve(input, SUPER(timeline), frame);
+    }
+
+    return time;
+}
+
+static void readColor(BinaryInput& input, float& r, float& g, float& b, float& a)
+{
+    r = input.readByte() / 255.0f;
+    g = input.readByte() / 255.0f;
+    b = input.readByte() / 255.0f;
+    a = input.readByte() / 255.0f;
+}
+
+static bool isValidIndex(int32_t index, int count)
+{
+    return index >= 0 && index < count;
+}
+
+static spAnimation* readAnimation(BinaryInput& input, const char* name, spSkeletonData* skeletonData, float scale)
+{
+    std::vector<spTimeline*> timelines;
+    float duration = 0.0f;
+    bool valid = true;
+    std::string string;
+
+    // slot timelines
+    for (int32_t i = 0, n = input.readVarint(true); i < n && valid; ++i)
+    {
+        int32_t slotIndex = input.readVarint(true);
+        valid = isValidIndex(slotIndex, skeletonData->slotsCount);
+
+        for (int32_t t = 0, timelineCount = input.readVarint(true); t < timelineCount && valid; ++t)
+        {
+            uint8_t timelineType = input.readByte();
+            int32_t frameCount = input.readVarint(true);
+
+            if (frameCount <= 0)
+            {
+                valid = false;
+                break;
+            }
+
+            switch (timelineType)
+            {
+                case SLOT_ATTACHMENT:
+                {
+                    spAttachmentTimeline* timeline = spAttachmentTimeline_create(frameCount);
+                    timeline->slotIndex = slotIndex;
+                    timelines.push_back(SUPER(timeline));
+
+                    for (int frame = 0; frame < frameCount; ++frame)
+                    {
+                        float time = input.readFloat();
+                        bool hasName = input.readString(string);
+                        spAttachmentTimeline_setFrame(timeline, frame, time, hasName ? string.c_str() : nullptr);
+                    }
+
+                    duration = std::max(duration, timeline->frames[frameCount - 1]);
+                    break;
+                }
+                case SLOT_COLOR:
+                {
+                    spColorTimeline* timeline = spColorTimeline_create(frameCount);
+                    timeline->slotIndex = slotIndex;
+                    timelines.push_back(SUPER(SUPER(timeline)));
+
+                    for (int frame = 0; frame < frameCount; ++frame)
+                    {
+                        float time = input.readFloat();
+                        float r, g, b, a;
+                        readColor(input, r, g, b, a);
+                        spColorTimeline_setFrame(timeline, frame, time, r, g, b, a);
+
+                        if (frame < frameCount - 1) readCurve(input, SUPER(timeline), frame);
+                        duration = std::max(duration, time);
+                    }
+                    break;
+                }
+                case SLOT_TWO_COLOR:
+                {
+                    spTwoColorTimeline* timeline = spTwoColorTimeline_create(frameCount);
+                    timeline->slotIndex = slotIndex;
+                    timelines.push_back(SUPER(SUPER(timeline)));
+
+                    for (int frame = 0; frame < frameCount; ++frame)
+                    {
+                        float time = input.readFloat();
+                        float r, g, b, a;
+                        readColor(input, r, g, b, a);
+                        uint32_t dark = static_cast<uint32_t>(input.readInt());
+                        spTwoColorTimeline_setFrame(timeline, frame, time, r, g, b, a,
+                                                    ((dark >> 16) & 0xFF) / 255.0f,
+                                                    ((dark >> 8) & 0xFF) / 255.0f,
+                                                    (dark & 0xFF) / 255.0f);
+
+                        if (frame < frameCount - 1) readCurve(input, SUPER(timeline), frame);
+                        duration = std::max(duration, time);
+                    }
+                    break;
+                }
+                default:
+                    valid = false;
+                    break;
+            }
+        }
+    }
+
+    // bone timelines
+    for (int32_t i = 0, n = input.readVarint(true); i < n && valid; ++i)
+    {
+        int32_t boneIndex = input.readVarint(true);
+        valid = isValidIndex(boneIndex, skeletonData->bonesCount);
+
+        for (int32_t t = 0, timelineCount = input.readVarint(true); t < timelineCount && valid; ++t)
+        {
+            uint8_t timelineType = input.readByte();
+            int32_t frameCount = input.readVarint(true);
+
+            if (frameCount <= 0)
+            {
+                valid = false;
+                break;
+            }
+
+            switch (timelineType)
+            {
+                case BONE_ROTATE:
+                {
+                    spRotateTimeline* timeline = spRotateTimeline_create(frameCount);
+                    timeline->boneIndex = boneIndex;
+                    timelines.push_back(SUPER(SUPER(timeline)));
+
+                    duration = std::max(duration, readCurveFrames(input, timeline, frameCount, 1, [](spRotateTimeline* target, int frame, float time, const float* values) {
+                        spRotateTimeline_setFrame(target, frame, time, values[0]);
+                    }));
+                    break;
+                }
+                case BONE_TRANSLATE:
+                case BONE_SCALE:
+                case BONE_SHEAR:
+                {
+                    spTranslateTimeline* timeline;
+                    float timelineScale = 1.0f;
+
+                    if (timelineType == BONE_SCALE)
+                        timeline = spScaleTimeline_create(frameCount);
+                    else if (timelineType == BONE_SHEAR)
+                        timeline = spShearTimeline_create(frameCount);
+                    else
+                    {
+                        timeline = spTranslateTimeline_create(frameCount);
+                        timelineScale = scale;
+                    }
+
+                    timeline->boneIndex = boneIndex;
+                    timelines.push_back(SUPER(SUPER(timeline)));
+
+                    duration = std::max(duration, readCurveFrames(input, timeline, frameCount, 2, [timelineScale](spTranslateTimeline* target, int frame, float time, const float* values) {
+                        spTranslateTimeline_setFrame(target, frame, time, values[0] * timelineScale, values[1] * timelineScale);
+                    }));
+                    break;
+                }
+                default:
+                    valid = false;
+                    break;
+            }
+        }
+    }
+
+    // IK constraint timelines
+    for (int32_t i = 0, n = input.readVarint(true); i < n && valid; ++i)
+    {
+        int32_t index = input.readVarint(true);
+        int32_t frameCount = input.readVarint(true);
+
+        if (!isValidIndex(index, skeletonData->ikConstraintsCount) || frameCount <= 0)
+        {
+            valid = false;
+            break;
+        }
+
+        spIkConstraintTimeline* timeline = spIkConstraintTimeline_create(frameCount);
+        timeline->ikConstraintIndex = index;
+        timelines.push_back(SUPER(SUPER(timeline)));
+
+        for (int frame = 0; frame < frameCount; ++frame)
+        {
+            float time = input.readFloat();
+            float mix = input.readFloat();
+            int8_t bendDirection = input.readSByte();
+            spIkConstraintTimeline_setFrame(timeline, frame, time, mix, bendDirection);
+
+            if (frame < frameCount - 1) readCurve(input, SUPER(timeline), frame);
+            duration = std::max(duration, time);
+        }
+    }
+
+    // transform constraint timelines
+    for (int32_t i = 0, n = input.readVarint(true); i < n && valid; ++i)
+    {
+        int32_t index = input.readVarint(true);
+        int32_t frameCount = input.readVarint(true);
+
+        if (!isValidIndex(index, skeletonData->transformConstraintsCount) || frameCount <= 0)
+        {
+            valid = false;
+            break;
+        }
+
+        spTransformConstraintTimeline* timeline = spTransformConstraintTimeline_create(frameCount);
+        timeline->transformConstraintIndex = index;
+        timelines.push_back(SUPER(SUPER(timeline)));
+
+        duration = std::max(duration, readCurveFrames(input, timeline, frameCount, 4, [](spTransformConstraintTimeline* target, int frame, float time, const float* values) {
+            spTransformConstraintTimeline_setFrame(target, frame, time, values[0], values[1], values[2], values[3]);
+        }));
+    }
+
+    // path constraint timelines
+    for (int32_t i = 0, n = input.readVarint(true); i < n && valid; ++i)
+    {
+        int32_t index = input.readVarint(true);
+
+        if (!isValidIndex(index, skeletonData->pathConstraintsCount))
+        {
+            valid = false;
+            break;
+        }
+
+        const spPathConstraintData* pathConstraintData = skeletonData->pathConstraints[index];
+
+        for (int32_t t = 0, timelineCount = input.readVarint(true); t < timelineCount && valid; ++t)
+        {
+            int8_t timelineType = input.readSByte();
+            int32_t frameCount = input.readVarint(true);
+
+            if (frameCount <= 0)
+            {
+                valid = false;
+                break;
+            }
+
+            switch (timelineType)
+            {
+                case PATH_POSITION:
+                case PATH_SPACING:
+                {
+                    spPathConstraintPositionTimeline* timeline;
+                    float timelineScale = 1.0f;
+
+                    if (timelineType == PATH_SPACING)
+                    {
+                        timeline = reinterpret_cast<spPathConstraintPositionTimeline*>(spPathConstraintSpacingTimeline_create(frameCount));
+                        if (pathConstraintData->spacingMode == SP_SPACING_MODE_LENGTH ||
+                            pathConstraintData->spacingMode == SP_SPACING_MODE_FIXED)
+                            timelineScale = scale;
+                    }
+                    else
+                    {
+                        timeline = spPathConstraintPositionTimeline_create(frameCount);
+                        if (pathConstraintData->positionMode == SP_POSITION_MODE_FIXED)
+                            timelineScale = scale;
+                    }
+
+                    timeline->pathConstraintIndex = index;
+                    timelines.push_back(SUPER(SUPER(timeline)));
+
+                    // the spacing timeline has the same layout, spine-c sets its frames the same way
+                    duration = std::max(duration, readCurveFrames(input, timeline, frameCount, 1, [timelineScale](spPathConstraintPositionTimeline* target, int frame, float time, const float* values) {
+                        spPathConstraintPositionTimeline_setFrame(target, frame, time, values[0] * timelineScale);
+                    }));
+                    break;
+                }
+                case PATH_MIX:
+                {
+                    spPathConstraintMixTimeline* timeline = spPathConstraintMixTimeline_create(frameCount);
+                    timeline->pathConstraintIndex = index;
+                    timelines.push_back(SUPER(SUPER(timeline)));
+
+                    duration = std::max(duration, readCurveFrames(input, timeline, frameCount, 2, [](spPathConstraintMixTimeline* target, int frame, float time, const float* values) {
+                        spPathConstraintMixTimeline_setFrame(target, frame, time, values[0], values[1]);
+                    }));
+                    break;
+                }
+                default:
+                    valid = false;
+                    break;
+            }
+        }
+    }
+
+    // deform timelines
+    for (int32_t i = 0, n = input.readVarint(true); i < n && valid; ++i)
+    {
+        int32_t skinIndex = input.readVarint(true);
+
+        if (!isValidIndex(skinIndex, skeletonData->skinsCount))
+        {
+            valid = false;
+            break;
+        }
+
+        const spSkin* skin = skeletonData->skins[skinIndex];
+
+        for (int32_t s = 0, slotCount = input.readVarint(true); s < slotCount && valid; ++s)
+        {
+            int32_t slotIndex = input.readVarint(true);
+
+            for (int32_t a = 0, attachmentCount = input.readVarint(true); a < attachmentCount && valid; ++a)
+            {
+                input.readString(string);
+                spAttachment* attachment = spSkin_getAttachment(skin, slotIndex, string.c_str());
+                int32_t frameCount = input.readVarint(true);
+
+                if (!attachment || attachment->type == SP_ATTACHMENT_REGION || attachment->type == SP_ATTACHMENT_POINT || frameCount <= 0)
+                {
+                    valid = false;
+                    break;
+                }
+
+                spVertexAttachment* vertexAttachment = SUB_CAST(spVertexAttachment, attachment);
+                bool weighted = vertexAttachment->bones != nullptr;
+                int deformLength = weighted ? vertexAttachment->verticesCount / 3 * 2 : vertexAttachment->verticesCount;
+                std::vector<float> deform(static_cast<size_t>(deformLength));
+
+                spDeformTimeline* timeline = spDeformTimeline_create(frameCount, deformLength);
+                timeline->slotIndex = slotIndex;
+                timeline->attachment = attachment;
+                timelines.push_back(SUPER(SUPER(timeline)));
+
+                for (int frame = 0; frame < frameCount && valid; ++frame)
+                {
+                    float time = input.readFloat();
+                    int32_t end = input.readVarint(true);
+
+                    if (!end && !weighted)
+                        std::copy(vertexAttachment->vertices, vertexAttachment->vertices + deformLength, deform.begin());
+                    else
+                    {
+                        std::fill(deform.begin(), deform.end(), 0.0f);
+
+                        if (end)
+                        {
+                            int32_t start = input.readVarint(true);
+                            end += start;
+
+                            if (start < 0 || end > deformLength)
+                            {
+                                valid = false;
+                                break;
+                            }
+
+                            for (int32_t v = start; v < end; ++v)
+                                deform[static_cast<size_t>(v)] = input.readFloat() * scale;
+
+                            if (!weighted)
+                                for (int v = 0; v < deformLength; ++v)
+                                    deform[static_cast<size_t>(v)] += vertexAttachment->vertices[v];
+                        }
+                    }
+
+                    spDeformTimeline_setFrame(timeline, frame, time, deform.data());
+
+                    if (frame < frameCount - 1) readCurve(input, SUPER(timeline), frame);
+                    duration = std::max(duration, time);
+                }
+            }
+        }
+    }
+
+    // draw order timeline
+    int32_t drawOrderCount = valid ? input.readVarint(true) : 0;
+
+    if (drawOrderCount > 0)
+    {
+        size_t slotCount = static_cast<size_t>(skeletonData->slotsCount);
+        spDrawOrderTimeline* timeline = spDrawOrderTimeline_create(drawOrderCount, skeletonData->slotsCount);
+        timelines.push_back(SUPER(timeline));
+
+        std::vector<int> drawOrder(slotCount);
+        std::vector<int> unchanged(slotCount);
+
+        for (int32_t frame = 0; frame < drawOrderCount && valid; ++frame)
+        {
+            float time = input.readFloat();
+            int32_t offsetCount = input.readVarint(true);
+            int originalIndex = 0;
+            size_t unchangedIndex = 0;
+
+            std::fill(drawOrder.begin(), drawOrder.end(), -1);
+
+            for (int32_t o = 0; o < offsetCount && valid; ++o)
+            {
+                int32_t slotIndex = input.readVarint(true);
+                if (!isValidIndex(slotIndex, skeletonData->slotsCount) || slotIndex < originalIndex)
+                {
+                    valid = false;
+                    break;
+                }
+
+                while (originalIndex != slotIndex) unchanged[unchangedIndex++] = originalIndex++;
+
+                int32_t newIndex = originalIndex + input.readVarint(true);
+                if (!isValidIndex(newIndex, skeletonData->slotsCount))
+                {
+                    valid = false;
+                    break;
+                }
+
+                drawOrder[static_cast<size_t>(newIndex)] = originalIndex++;
+            }
+
+            if (!valid) break;
+
+            while (originalIndex < skeletonData->slotsCount) unchanged[unchangedIndex++] = originalIndex++;
+
+            for (size_t s = slotCount; s-- > 0 && valid;)
+            {
+                if (drawOrder[s] != -1) continue;
+
+                // two slots moved to the same place
+                if (unchangedIndex == 0)
+                    valid = false;
+                else
+                    drawOrder[s] = unchanged[--unchangedIndex];
+            }
+
+            if (!valid) break;
+
+            spDrawOrderTimeline_setFrame(timeline, frame, time, drawOrder.data());
+            duration = std::max(duration, time);
+        }
+    }
+
+    // event timeline
+    int32_t eventCount = valid ? input.readVarint(true) : 0;
+
+    if (eventCount > 0)
+    {
+        spEventTimeline* timeline = spEventTimeline_create(eventCount);
+        timelines.push_back(SUPER(timeline));
+
+        for (int32_t frame = 0; frame < eventCount; ++frame)
+        {
+            float time = input.readFloat();
+            int32_t eventIndex = input.readVarint(true);
+
+            if (!isValidIndex(eventIndex, skeletonData->eventsCount))
+            {
+                valid = false;
+                break;
+            }
+
+            spEventData* eventData = skeletonData->events[eventIndex];
+            spEvent* event = spEvent_create(time, eventData);
+            event->intValue = input.readVarint(false);
+            event->floatValue = input.readFloat();
+
+            if (input.readBoolean())
+            {
+                if (input.readString(string)) MALLOC_STR(event->stringValue, string.c_str());
+            }
+            else if (eventData->stringValue)
+                MALLOC_STR(event->stringValue, eventData->stringValue);
+
+            spEventTimeline_setFrame(timeline, frame, event);
+            duration = std::max(duration, time);
+        }
+    }
+
+    if (!valid || input.hasError())
+    {
+        for (spTimeline* timeline : timelines)
+            spTimeline_dispose(timeline);
+
+        return nullptr;
+    }
+
+    spAnimation* animation = spAnimation_create(name, static_cast<int>(timelines.size()));
+    std::copy(timelines.begin(), timelines.end(), animation->timelines);
+    animation->duration = duration;
+
+    return animation;
+}
+
+namespace spine
+{
+    bool AnimationLoader::init(const std::vector<uint8_t>& fileData, std::vector<uint8_t>& skeletonFileData)
+    {
+        BinaryInput input(fileData.data(), fileData.data() + fileData.size());
+
+        // header
+        input.skipString();
+        std::string version;
+        input.readString(version);
+        if (version.compare(0, 4, "3.6.") != 0) return false;
+
+        input.skipFloats(2);
+        bool nonessential = input.readBoolean();
+
+        if (nonessential)
+        {
+            input.skipFloats(1);
+            input.skipString();
+        }
+
+        // bones
+        for (int32_t i = 0, n = input.readVarint(true); i < n && !input.hasError(); ++i)
+        {
+            input.skipString();
+            if (i > 0) input.readVarint(true);
+            input.skipFloats(8);
+            input.readVarint(true);
+            if (nonessential) input.readInt();
+        }
+
+        // slots
+        for (int32_t i = 0, n = input.readVarint(true); i < n && !input.hasError(); ++i)
+        {
+            input.skipString();
+            input.readVarint(true);
+            input.readInt();
+            input.readInt();
+            input.skipString();
+            input.readVarint(true);
+        }
+
+        // IK constraints
+        for (int32_t i = 0, n = input.readVarint(true); i < n && !input.hasError(); ++i)
+        {
+            input.skipString();
+            input.readVarint(true);
+            for (int32_t b = 0, boneCount = input.readVarint(true); b < boneCount && !input.hasError(); ++b)
+                input.readVarint(true);
+            input.readVarint(true);
+            input.skipFloats(1);
+            input.readSByte();
+        }
+
+        // transform constraints
+        for (int32_t i = 0, n = input.readVarint(true); i < n && !input.hasError(); ++i)
+        {
+            input.skipString();
+            input.readVarint(true);
+            for (int32_t b = 0, boneCount = input.readVarint(true); b < boneCount && !input.hasError(); ++b)
+                input.readVarint(true);
+            input.readVarint(true);
+            input.readBoolean();
+            input.readBoolean();
+            input.skipFloats(10);
+        }
+
+        // path constraints
+        for (int32_t i = 0, n = input.readVarint(true); i < n && !input.hasError(); ++i)
+        {
+            input.skipString();
+            input.readVarint(true);
+            for (int32_t b = 0, boneCount = input.readVarint(true); b < boneCount && !input.hasError(); ++b)
+                input.readVarint(true);
+            input.readVarint(true);
+            input.readVarint(true);
+            input.readVarint(true);
+            input.readVarint(true);
+            input.skipFloats(5);
+        }
+
+        // default skin and named skins
+        skipSkin(input, nonessential);
+
+        for (int32_t i = 0, n = input.readVarint(true); i < n && !input.hasError(); ++i)
+        {
+            input.skipString();
+            skipSkin(input, nonessential);
+        }
+
+        // events
+        for (int32_t i = 0, n = input.readVarint(true); i < n && !input.hasError(); ++i)
+        {
+            input.skipString();
+            input.readVarint(false);
+            input.skipFloats(1);
+            input.skipString();
+        }
+
+        if (input.hasError()) return false;
+
+        size_t animationsOffset = input.getOffset();
+
+        animations.clear();
+
+        for (int32_t i = 0, n = input.readVarint(true); i < n && !input.hasError(); ++i)
+        {
+            Animation animation;
+            if (!input.readString(animation.name)) return false;
+
+            animation.offset = input.getOffset() - animationsOffset;
+            skipAnimation(input);
+            animation.size = input.getOffset() - animationsOffset - animation.offset;
+
+            animations.push_back(animation);
+        }
+
+        if (input.hasError() || !input.isEnd()) return false;
+
+        // the same file with no animations
+        skeletonFileData.assign(fileData.begin(), fileData.begin() + static_cast<std::ptrdiff_t>(animationsOffset));
+        skeletonFileData.push_back(0);
+
+        data.assign(fileData.begin() + static_cast<std::ptrdiff_t>(animationsOffset), fileData.end());
+
+        return true;
+    }
+
+    size_t AnimationLoader::findAnimation(const std::string& name) const
+    {
+        for (size_t i = 0; i < animations.size(); ++i)
+            if (animations[i].name == name) return i;
+
+        return animations.size();
+    }
+
+    spAnimation* AnimationLoader::readAnimation(size_t index, spSkeletonData* skeletonData, float scale) const
+    {
+        if (index >= animations.size()) return nullptr;
+
+        const Animation& animation = animations[index];
+        const uint8_t* begin = data.data() + animation.offset;
+        BinaryInput input(begin, begin + animation.size);
+
+        return ::readAnimation(input, animation.name.c_str(), skeletonData, scale);
+    }
+
+    uint64_t AnimationLoader::getMemory() const
+    {
+        uint64_t result = sizeof(AnimationLoader) + data.capacity() + animations.capacity() * sizeof(Animation);
+
+        for (const Animation& animation : animations)
+            result += animation.name.capacity();
+
+        return result;
+    }
+}
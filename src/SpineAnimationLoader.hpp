@@ -0,0 +1,43 @@
+// Copyright (C) 2017 Elviss Strazdins
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct spSkeletonData;
+struct spAnimation;
+
+namespace spine
+{
+    // Splits a binary skeleton file into the skeleton without animations, which spine-c loads as usual,
+    // and the encoded animations, which are kept in memory and decoded one at a time when needed
+    class AnimationLoader
+    {
+    public:
+        // returns false if the file is not a skeleton file this loader understands
+        bool init(const std::vector<uint8_t>& fileData, std::vector<uint8_t>& skeletonFileData);
+
+        size_t getAnimationCount() const { return animations.size(); }
+        const std::string& getAnimationName(size_t index) const { return animations[index].name; }
+        // returns getAnimationCount() if there is no animation with the name
+        size_t findAnimation(const std::string& name) const;
+
+        // decodes the animation like spSkeletonBinary_readSkeletonData would, returns nullptr if the data is invalid
+        spAnimation* readAnimation(size_t index, spSkeletonData* skeletonData, float scale) const;
+
+        uint64_t getMemory() const;
+
+    private:
+        struct Animation
+        {
+            std::string name;
+            size_t offset;
+            size_t size;
+        };
+
+        std::vector<uint8_t> data;
+        std::vector<Animation> animations;
+    };
+}
@@ -0,0 +1,518 @@
+// Copyright (C) 2017 Elviss Strazdins
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "SpineAtlasPage.hpp"
+#include "spine/spine.h"
+
+static const uint8_t KTX_IDENTIFIER[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+static const uint32_t KTX_ENDIANNESS = 0x04030201;
+static const size_t KTX_HEADER_SIZE = 64;
+
+static const uint32_t GL_ALPHA_FORMAT = 0x1906;
+static const uint32_t GL_RGBA_FORMAT = 0x1908;
+static const uint32_t GL_ALPHA8 = 0x803C;
+static const uint32_t GL_RGBA8 = 0x8058;
+static const uint32_t GL_ETC1_RGB8_OES = 0x8D64;
+static const uint32_t GL_COMPRESSED_RGB8_ETC2 = 0x9274;
+static const uint32_t GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2 = 0x9276;
+static const uint32_t GL_COMPRESSED_RGBA8_ETC2_EAC = 0x9278;
+static const uint32_t GL_COMPRESSED_RGBA_ASTC_4x4 = 0x93B0;
+static const uint32_t GL_COMPRESSED_RGBA_ASTC_12x12 = 0x93BD;
+
+static const int ETC_MODIFIERS[8][2] = {
+    {2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183}
+};
+
+static const int ETC_DISTANCES[8] = {3, 6, 11, 16, 23, 32, 41, 64};
+
+static const int EAC_MODIFIERS[16][8] = {
+    {-3, -6, -9, -15, 2, 5, 8, 14},
+    {-3, -7, -10, -13, 2, 6, 9, 12},
+    {-2, -5, -8, -13, 1, 4, 7, 12},
+    {-2, -4, -6, -13, 1, 3, 5, 12},
+    {-3, -6, -8, -12, 2, 5, 7, 11},
+    {-3, -7, -9, -11, 2, 6, 8, 10},
+    {-4, -7, -8, -11, 3, 6, 7, 10},
+    {-3, -5, -8, -11, 2, 4, 7, 10},
+    {-2, -6, -8, -10, 1, 5, 7, 9},
+    {-2, -5, -8, -10, 1, 4, 7, 9},
+    {-2, -4, -8, -10, 1, 3, 7, 9},
+    {-2, -5, -7, -10, 1, 4, 6, 9},
+    {-3, -4, -7, -10, 2, 3, 6, 9},
+    {-1, -2, -3, -10, 0, 1, 2, 9},
+    {-4, -6, -8, -9, 3, 5, 7, 8},
+    {-3, -5, -7, -9, 2, 4, 6, 8}
+};
+
+static uint8_t clamp(int value)
+{
+    return static_cast<uint8_t>(std::min(std::max(value, 0), 255));
+}
+
+static int extend4(int value) { return (value << 4) | value; }
+static int extend5(int value) { return (value << 3) | (value >> 2); }
+static int extend6(int value) { return (value << 2) | (value >> 4); }
+static int extend7(int value) { return (value << 1) | (value >> 6); }
+
+struct Block
+{
+    // RGBA of the 16 pixels in row order
+    uint8_t pixels[16][4];
+
+    void set(int x, int y, int r, int g, int b, int a = 255)
+    {
+        uint8_t* pixel = pixels[y * 4 + x];
+        pixel[0] = clamp(r);
+        pixel[1] = clamp(g);
+        pixel[2] = clamp(b);
+        pixel[3] = clamp(a);
+    }
+};
+
+static void decodePaintColors(const int paint[4][3], uint32_t indices, bool punchthrough, Block& block)
+{
+    for (int x = 0; x < 4; ++x)
+    {
+        for (int y = 0; y < 4; ++y)
+        {
+            int i = x * 4 + y;
+            int index = static_cast<int>(((indices >> (i + 16)) & 1) << 1 | ((indices >> i) & 1));
+
+            if (punchthrough && index == 2)
+                block.set(x, y, 0, 0, 0, 0);
+            else
+                block.set(x, y, paint[index][0], paint[index][1], paint[index][2]);
+        }
+    }
+}
+
+// decodes the colors of an ETC1 or ETC2 block, in punchthrough blocks the differential bit marks opaque blocks
+static void decodeETC2Block(const uint8_t* data, bool etc1, bool punchthrough, Block& block)
+{
+    uint32_t indices = (static_cast<uint32_t>(data[4]) << 24) | (static_cast<uint32_t>(data[5]) << 16) |
+        (static_cast<uint32_t>(data[6]) << 8) | static_cast<uint32_t>(data[7]);
+
+    bool differential = punchthrough || (data[3] & 0x02);
+    bool transparent = punchthrough && !(data[3] & 0x02);
+    int base[2][3];
+
+    if (differential)
+    {
+        int r = data[0] >> 3;
+        int g = data[1] >> 3;
+        int b = data[2] >> 3;
+        int dr = ((data[0] & 0x07) ^ 0x04) - 0x04;
+        int dg = ((data[1] & 0x07) ^ 0x04) - 0x04;
+        int db = ((data[2] & 0x07) ^ 0x04) - 0x04;
+
+        if (!etc1 && (r + dr < 0 || r + dr > 31))
+        {
+            // T mode
+            int r1 = extend4(((data[0] >> 1) & 0x0C) | (data[0] & 0x03));
+            int g1 = extend4(data[1] >> 4);
+            int b1 = extend4(data[1] & 0x0F);
+            int r2 = extend4(data[2] >> 4);
+            int g2 = extend4(data[2] & 0x0F);
+            int b2 = extend4(data[3] >> 4);
+            int distance = ETC_DISTANCES[((data[3] >> 1) & 0x06) | (data[3] & 0x01)];
+
+            int paint[4][3] = {
+                {r1, g1, b1},
+                {r2 + distance, g2 + distance, b2 + distance},
+                {r2, g2, b2},
+                {r2 - distance, g2 - distance, b2 - distance}
+            };
+
+            decodePaintColors(paint, indices, transparent, block);
+            return;
+        }
+
+        if (!etc1 && (g + dg < 0 || g + dg > 31))
+        {
+            // H mode
+            int r1 = (data[0] >> 3) & 0x0F;
+            int g1 = ((data[0] & 0x07) << 1) | ((data[1] >> 4) & 0x01);
+            int b1 = (data[1] & 0x08) | ((data[1] & 0x03) << 1) | (data[2] >> 7);
+            int r2 = (data[2] >> 3) & 0x0F;
+            int g2 = ((data[2] & 0x07) << 1) | (data[3] >> 7);
+            int b2 = (data[3] >> 3) & 0x0F;
+            int order = ((r1 << 8) | (g1 << 4) | b1) >= ((r2 << 8) | (g2 << 4) | b2) ? 1 : 0;
+            int distance = ETC_DISTANCES[(data[3] & 0x04) | ((data[3] & 0x01) << 1) | order];
+
+            r1 = extend4(r1); g1 = extend4(g1); b1 = extend4(b1);
+            r2 = extend4(r2); g2 = extend4(g2); b2 = extend4(b2);
+
+            int paint[4][3] = {
+                {r1 + distance, g1 + distance, b1 + distance},
+                {r1 - distance, g1 - distance, b1 - distance},
+                {r2 + distance, g2 + distance, b2 + distance},
+                {r2 - distance, g2 - distance, b2 - distance}
+            };
+
+            decodePaintColors(paint, indices, transparent, block);
+            return;
+        }
+
+        if (!etc1 && (b + db < 0 || b + db > 31))
+        {
+            // planar mode, always opaque
+            int ro = extend6((data[0] >> 1) & 0x3F);
+            int go = extend7(((data[0] & 0x01) << 6) | ((data[1] >> 1) & 0x3F));
+            int bo = extend6(((data[1] & 0x01) << 5) | (data[2] & 0x18) | ((data[2] & 0x03) << 1) | (data[3] >> 7));
+            int rh = extend6((((data[3] >> 2) & 0x1F) << 1) | (data[3] & 0x01));
+            int gh = extend7(data[4] >> 1);
+            int bh = extend6(((data[4] & 0x01) << 5) | (data[5] >> 3));
+            int rv = extend6(((data[5] & 0x07) << 3) | (data[6] >> 5));
+            int gv = extend7(((data[6] & 0x1F) << 2) | (data[7] >> 6));
+            int bv = extend6(data[7] & 0x3F);
+
+            for (int y = 0; y < 4; ++y)
+                for (int x = 0; x < 4; ++x)
+                    block.set(x, y,
+                              (x * (rh - ro) + y * (rv - ro) + 4 * ro + 2) >> 2,
+                              (x * (gh - go) + y * (gv - go) + 4 * go + 2) >> 2,
+                              (x * (bh - bo) + y * (bv - bo) + 4 * bo + 2) >> 2);
+            return;
+        }
+
+        base[0][0] = extend5(r);
+        base[0][1] = extend5(g);
+        base[0][2] = extend5(b);
+        base[1][0] = extend5(r + dr);
+        base[1][1] = extend5(g + dg);
+        base[1][2] = extend5(b + db);
+    }
+    else
+    {
+        base[0][0] = extend4(data[0] >> 4);
+        base[0][1] = extend4(data[1] >> 4);
+        base[0][2] = extend4(data[2] >> 4);
+        base[1][0] = extend4(data[0] & 0x0F);
+        base[1][1] = extend4(data[1] & 0x0F);
+        base[1][2] = extend4(data[2] & 0x0F);
+    }
+
+    const int* modifiers[2] = {ETC_MODIFIERS[data[3] >> 5], ETC_MODIFIERS[(data[3] >> 2) & 0x07]};
+    bool flip = (data[3] & 0x01) != 0;
+
+    for (int x = 0; x < 4; ++x)
+    {
+        for (int y = 0; y < 4; ++y)
+        {
+            int i = x * 4 + y;
+            int subblock = flip ? (y >= 2) : (x >= 2);
+            bool negative = ((indices >> (i + 16)) & 1) != 0;
+            bool large = ((indices >> i) & 1) != 0;
+
+            if (transparent && negative && !large)
+            {
+                block.set(x, y, 0, 0, 0, 0);
+                continue;
+            }
+
+            // transparent blocks have no small modifiers
+            int modifier = (transparent && !large) ? 0 : modifiers[subblock][large ? 1 : 0];
+            if (negative) modifier = -modifier;
+
+            block.set(x, y,
+                      base[subblock][0] + modifier,
+                      base[subblock][1] + modifier,
+                      base[subblock][2] + modifier);
+        }
+    }
+}
+
+static void decodeEACBlock(const uint8_t* data, Block& block)
+{
+    int base = data[0];
+    int multiplier = data[1] >> 4;
+    const int* modifiers = EAC_MODIFIERS[data[1] & 0x0F];
+
+    uint64_t indices = 0;
+    for (int i = 2; i < 8; ++i)
+        indices = (indices << 8) | data[i];
+
+    for (int x = 0; x < 4; ++x)
+    {
+        for (int y = 0; y < 4; ++y)
+        {
+            int i = x * 4 + y;
+            int index = static_cast<int>((indices >> (45 - i * 3)) & 0x07);
+            block.pixels[y * 4 + x][3] = clamp(base + modifiers[index] * multiplier);
+        }
+    }
+}
+
+static uint32_t readUInt32(const uint8_t* data, bool swap)
+{
+    uint32_t result;
+    memcpy(&result, data, sizeof(result));
+
+    if (swap)
+        result = ((result & 0xFF) << 24) | ((result & 0xFF00) << 8) | ((result >> 8) & 0xFF00) | (result >> 24);
+
+    return result;
+}
+
+static uint32_t getPixelSize(ouzel::graphics::PixelFormat pixelFormat)
+{
+    switch (pixelFormat)
+    {
+        case ouzel::graphics::PixelFormat::A8_UNORM:
+        case ouzel::graphics::PixelFormat::R8_UNORM:
+            return 1;
+        case ouzel::graphics::PixelFormat::RG8_UNORM:
+            return 2;
+        default:
+            return 4;
+    }
+}
+
+namespace spine
+{
+    bool loadAtlasPageImage(const std::string& filename, AtlasPageImage& image)
+    {
+        std::string ktxFilename = filename.substr(0, filename.find_last_of('.')) + ".ktx";
+
+        if (ouzel::engine->getFileSystem().fileExists(ktxFilename))
+        {
+            try
+            {
+                std::vector<uint8_t> fileData = ouzel::engine->getFileSystem().readFile(ktxFilename);
+
+                if (decodeKTX(fileData, image))
+                {
+                    image.filename = ktxFilename;
+                    return true;
+                }
+            }
+            catch (const std::exception& e)
+            {
+                ouzel::Log(ouzel::Log::Level::ERR) << e.what();
+            }
+
+            ouzel::Log(ouzel::Log::Level::WARN) << "Failed to load " << ktxFilename << ", loading " << filename;
+        }
+
+        // the file system and the image decoder throw on failure
+        try
+        {
+            ouzel::graphics::ImageDataSTB imageData(ouzel::engine->getFileSystem().readFile(filename),
+                                                    ouzel::graphics::PixelFormat::RGBA8_UNORM);
+
+            image.data = imageData.getData();
+            image.width = static_cast<uint32_t>(imageData.getSize().width);
+            image.height = static_cast<uint32_t>(imageData.getSize().height);
+        }
+        catch (const std::exception& e)
+        {
+            ouzel::Log(ouzel::Log::Level::ERR) << e.what();
+            return false;
+        }
+
+        image.pixelFormat = ouzel::graphics::PixelFormat::RGBA8_UNORM;
+        image.filename = filename;
+        image.fileFormat = "RGBA8";
+
+        return true;
+    }
+
+    bool decodeKTX(const std::vector<uint8_t>& fileData, AtlasPageImage& image)
+    {
+        if (fileData.size() < KTX_HEADER_SIZE || memcmp(fileData.data(), KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0)
+        {
+            ouzel::Log(ouzel::Log::Level::ERR) << "Not a KTX file";
+            return false;
+        }
+
+        const uint8_t* header = fileData.data() + sizeof(KTX_IDENTIFIER);
+        bool swap = readUInt32(header, false) != KTX_ENDIANNESS;
+        uint32_t format = readUInt32(header + 12, swap);
+        uint32_t internalFormat = readUInt32(header + 16, swap);
+        uint32_t width = readUInt32(header + 24, swap);
+        uint32_t height = readUInt32(header + 28, swap);
+        uint32_t depth = readUInt32(header + 32, swap);
+        uint32_t faces = readUInt32(header + 40, swap);
+        uint32_t keyValueSize = readUInt32(header + 48, swap);
+
+        if (!width || !height || depth > 1 || faces != 1 || width > 16384 || height > 16384)
+        {
+            ouzel::Log(ouzel::Log::Level::ERR) << "KTX file is not a 2D texture";
+            return false;
+        }
+
+        // only the first mip level is used, the renderer builds the rest if needed
+        size_t offset = KTX_HEADER_SIZE + keyValueSize;
+        if (offset + 4 > fileData.size()) return false;
+
+        size_t imageSize = readUInt32(fileData.data() + offset, swap);
+        offset += 4;
+        if (offset + imageSize > fileData.size()) return false;
+
+        const uint8_t* pixels = fileData.data() + offset;
+        size_t pixelCount = static_cast<size_t>(width) * height;
+
+        image.width = width;
+        image.height = height;
+        image.pixelFormat = ouzel::graphics::PixelFormat::RGBA8_UNORM;
+        image.data.resize(pixelCount * 4);
+
+        if (internalFormat == GL_RGBA8 || (internalFormat == GL_RGBA_FORMAT && format == GL_RGBA_FORMAT))
+        {
+            if (imageSize < pixelCount * 4) return false;
+
+            std::copy(pixels, pixels + pixelCount * 4, image.data.begin());
+            image.fileFormat = "RGBA8";
+        }
+        else if (internalFormat == GL_ALPHA8 || (internalFormat == GL_ALPHA_FORMAT && format == GL_ALPHA_FORMAT))
+        {
+            if (imageSize < pixelCount) return false;
+
+            for (size_t i = 0; i < pixelCount; ++i)
+            {
+                image.data[i * 4] = 255;
+                image.data[i * 4 + 1] = 255;
+                image.data[i * 4 + 2] = 255;
+                image.data[i * 4 + 3] = pixels[i];
+            }
+
+            image.fileFormat = "A8";
+        }
+        else if (internalFormat == GL_ETC1_RGB8_OES ||
+                 internalFormat == GL_COMPRESSED_RGB8_ETC2 ||
+                 internalFormat == GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2 ||
+                 internalFormat == GL_COMPRESSED_RGBA8_ETC2_EAC)
+        {
+            bool alpha = internalFormat == GL_COMPRESSED_RGBA8_ETC2_EAC;
+            size_t blockSize = alpha ? 16 : 8;
+            uint32_t blocksX = (width + 3) / 4;
+            uint32_t blocksY = (height + 3) / 4;
+
+            if (imageSize < static_cast<size_t>(blocksX) * blocksY * blockSize) return false;
+
+            for (uint32_t blockY = 0; blockY < blocksY; ++blockY)
+            {
+                for (uint32_t blockX = 0; blockX < blocksX; ++blockX)
+                {
+                    const uint8_t* blockData = pixels + (static_cast<size_t>(blockY) * blocksX + blockX) * blockSize;
+                    Block block;
+
+                    decodeETC2Block(alpha ? blockData + 8 : blockData,
+                                    internalFormat == GL_ETC1_RGB8_OES,
+                                    internalFormat == GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2,
+                                    block);
+                    if (alpha) decodeEACBlock(blockData, block);
+
+                    // blocks on the right and bottom edges can be partly outside the image
+                    for (uint32_t y = 0; y < 4 && blockY * 4 + y < height; ++y)
+                    {
+                        for (uint32_t x = 0; x < 4 && blockX * 4 + x < width; ++x)
+                        {
+                            size_t pixel = (static_cast<size_t>(blockY * 4 + y) * width + blockX * 4 + x) * 4;
+                            std::copy(block.pixels[y * 4 + x], block.pixels[y * 4 + x] + 4, image.data.begin() + static_cast<std::ptrdiff_t>(pixel));
+                        }
+                    }
+                }
+            }
+
+            switch (internalFormat)
+            {
+                case GL_ETC1_RGB8_OES: image.fileFormat = "ETC1"; break;
+                case GL_COMPRESSED_RGB8_ETC2: image.fileFormat = "ETC2_RGB8"; break;
+                case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2: image.fileFormat = "ETC2_RGB8A1"; break;
+                default: image.fileFormat = "ETC2_RGBA8"; break;
+            }
+        }
+        else
+        {
+            if (internalFormat >= GL_COMPRESSED_RGBA_ASTC_4x4 && internalFormat <= GL_COMPRESSED_RGBA_ASTC_12x12)
+                ouzel::Log(ouzel::Log::Level::ERR) << "ASTC textures are not supported";
+            else
+                ouzel::Log(ouzel::Log::Level::ERR) << "Unsupported KTX format " << internalFormat;
+            return false;
+        }
+
+        return true;
+    }
+
+    void convertAtlasPageImage(const spAtlasPage* page, AtlasPageImage& image)
+    {
+        if (page->format != SP_ATLAS_ALPHA || image.pixelFormat != ouzel::graphics::PixelFormat::RGBA8_UNORM) return;
+
+        size_t pixelCount = static_cast<size_t>(image.width) * image.height;
+
+        // grayscale images have no alpha channel of their own
+        bool opaque = true;
+        for (size_t i = 0; i < pixelCount && opaque; ++i)
+            opaque = image.data[i * 4 + 3] == 255;
+
+        size_t channel = opaque ? 0 : 3;
+
+        for (size_t i = 0; i < pixelCount; ++i)
+            image.data[i] = image.data[i * 4 + channel];
+
+        image.data.resize(pixelCount);
+        image.pixelFormat = ouzel::graphics::PixelFormat::A8_UNORM;
+    }
+
+    uint64_t getTextureMemory(uint32_t width, uint32_t height, ouzel::graphics::PixelFormat pixelFormat, bool mipmaps)
+    {
+        uint64_t size = 0;
+
+        for (;;)
+        {
+            size += static_cast<uint64_t>(width) * height * getPixelSize(pixelFormat);
+            if (!mipmaps || (width <= 1 && height <= 1)) break;
+
+            width = std::max(width / 2, 1U);
+            height = std::max(height / 2, 1U);
+        }
+
+        return size;
+    }
+
+    bool hasAtlasPageMipmaps(const spAtlasPage* page)
+    {
+        // mipmaps are only sampled with mipmap filters
+        return page->minFilter != SP_ATLAS_NEAREST && page->minFilter != SP_ATLAS_LINEAR;
+    }
+
+    ouzel::graphics::Texture::Filter getAtlasPageFilter(const spAtlasPage* page)
+    {
+        if (page->magFilter == SP_ATLAS_NEAREST)
+            return ouzel::graphics::Texture::Filter::POINT;
+
+        switch (page->minFilter)
+        {
+            case SP_ATLAS_NEAREST:
+            case SP_ATLAS_LINEAR:
+            case SP_ATLAS_MIPMAP_NEAREST_NEAREST:
+            case SP_ATLAS_MIPMAP_LINEAR_NEAREST:
+                return ouzel::graphics::Texture::Filter::BILINEAR;
+            // MipMap is linear within and between the mip levels
+            case SP_ATLAS_MIPMAP:
+            case SP_ATLAS_MIPMAP_NEAREST_LINEAR:
+            case SP_ATLAS_MIPMAP_LINEAR_LINEAR:
+                return ouzel::graphics::Texture::Filter::TRILINEAR;
+            default:
+                return ouzel::graphics::Texture::Filter::DEFAULT;
+        }
+    }
+
+    const char* getAtlasFormatName(const spAtlasPage* page)
+    {
+        switch (page->format)
+        {
+            case SP_ATLAS_ALPHA: return "Alpha";
+            case SP_ATLAS_INTENSITY: return "Intensity";
+            case SP_ATLAS_LUMINANCE_ALPHA: return "LuminanceAlpha";
+            case SP_ATLAS_RGB565: return "RGB565";
+            case SP_ATLAS_RGBA4444: return "RGBA4444";
+            case SP_ATLAS_RGB888: return "RGB888";
+            case SP_ATLAS_RGBA8888: return "RGBA8888";
+            default: return "unknown";
+        }
+    }
+}
@@ -0,0 +1,60 @@
+// Copyright (C) 2017 Elviss Strazdins
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ouzel.hpp"
+
+struct spAtlasPage;
+
+namespace spine
+{
+    struct AtlasPageImage
+    {
+        std::vector<uint8_t> data;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        ouzel::graphics::PixelFormat pixelFormat = ouzel::graphics::PixelFormat::RGBA8_UNORM;
+        // file the pixels were read from and the encoding of its pixels
+        std::string filename;
+        std::string fileFormat;
+    };
+
+    struct AtlasPageReport
+    {
+        std::string page;
+        std::string filename;
+        std::string fileFormat;
+        // format line of the atlas
+        std::string atlasFormat;
+        ouzel::graphics::PixelFormat pixelFormat = ouzel::graphics::PixelFormat::RGBA8_UNORM;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        bool mipmaps = false;
+        // texture memory, and what the page would take as a mipmapped RGBA8 texture
+        uint64_t memory = 0;
+        uint64_t fullMemory = 0;
+    };
+
+    // reads the KTX file with the same name as the page image if there is one, the page image otherwise,
+    // the pixels are always RGBA8
+    bool loadAtlasPageImage(const std::string& filename, AtlasPageImage& image);
+
+    // KTX 1.1 with RGBA8, alpha, ETC1, ETC2 or ETC2 + EAC pixels, the renderer only uploads
+    // uncompressed textures, so compressed blocks are decoded on the CPU and take as much
+    // texture memory as a PNG page
+    bool decodeKTX(const std::vector<uint8_t>& fileData, AtlasPageImage& image);
+
+    // converts RGBA8 pixels to the smallest pixel format the renderer has for the atlas format,
+    // the renderer has no 16-bit formats, so only Alpha pages get smaller
+    void convertAtlasPageImage(const spAtlasPage* page, AtlasPageImage& image);
+
+    bool hasAtlasPageMipmaps(const spAtlasPage* page);
+    // the renderer has one filter for minification and magnification
+    ouzel::graphics::Texture::Filter getAtlasPageFilter(const spAtlasPage* page);
+
+    uint64_t getTextureMemory(uint32_t width, uint32_t height, ouzel::graphics::PixelFormat pixelFormat, bool mipmaps);
+    const char* getAtlasFormatName(const spAtlasPage* page);
+}
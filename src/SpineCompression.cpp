@@ -0,0 +1,341 @@
+// Copyright (C) 2017 Elviss Strazdins
+
+#include <algorithm>
+#include <cmath>
+#include "SpineCompression.hpp"
+#include "SpineCurves.hpp"
+#include "SpineProfiler.hpp"
+#include "SpineSampler.hpp"
+#include "spine/spine.h"
+#include "spine/extension.h"
+
+static const float QUANTIZATION_STEPS = 65535.0f;
+static const int ROTATE_ENTRIES = 2;
+
+static float wrapRotation(float rotation)
+{
+    return rotation - (16384 - static_cast<int>(16384.499999999996 - rotation / 360.0f)) * 360.0f;
+}
+
+static void samplePose(spSkeleton* skeleton, const spAnimation* animation, float sampleRate, std::vector<float>& pose)
+{
+    pose.clear();
+
+    int sampleCount = static_cast<int>(std::ceil(animation->duration * sampleRate)) + 1;
+
+    for (int s = 0; s < sampleCount; ++s)
+    {
+        float time = std::min(static_cast<float>(s) / sampleRate, animation->duration);
+
+        spSkeleton_setToSetupPose(skeleton);
+        spAnimation_apply(animation, skeleton, time, time, 0, nullptr, nullptr, 1.0f, SP_MIX_POSE_SETUP, SP_MIX_DIRECTION_IN);
+        spSkeleton_updateWorldTransform(skeleton);
+
+        for (int b = 0; b < skeleton->bonesCount; ++b)
+        {
+            const spBone* bone = skeleton->bones[b];
+            pose.push_back(bone->worldX);
+            pose.push_back(bone->worldY);
+            pose.push_back(bone->rotation);
+        }
+    }
+}
+
+// keyframes to keep so that linear interpolation over the removed ones stays within the tolerance,
+// only keyframes between linear segments can be removed
+static std::vector<int> findKeyframes(const float* frames, const float* curves, int frameCount, int entries, float tolerance, bool rotation)
+{
+    int channels = entries - 1;
+    std::vector<int> kept;
+    kept.push_back(0);
+
+    for (int frame = 1; frame < frameCount - 1; ++frame)
+    {
+        int first = kept.back();
+        int last = frame + 1;
+        bool removable = true;
+
+        for (int segment = first; segment < last && removable; ++segment)
+            if (curves[segment * spine::CURVE_SIZE] != spine::CURVE_LINEAR) removable = false;
+
+        float firstTime = frames[first * entries];
+        float lastTime = frames[last * entries];
+
+        for (int middle = first + 1; middle < last && removable; ++middle)
+        {
+            float percent = (frames[middle * entries] - firstTime) / (lastTime - firstTime);
+
+            for (int c = 1; c <= channels; ++c)
+            {
+                float firstValue = frames[first * entries + c];
+                float difference = frames[last * entries + c] - firstValue;
+                if (rotation) difference = wrapRotation(difference);
+
+                float error = firstValue + difference * percent - frames[middle * entries + c];
+                if (rotation) error = wrapRotation(error);
+
+                if (std::fabs(error) > tolerance)
+                {
+                    removable = false;
+                    break;
+                }
+            }
+        }
+
+        if (!removable) kept.push_back(frame);
+    }
+
+    kept.push_back(frameCount - 1);
+
+    return kept;
+}
+
+// spAnimationState reads the keyframes of rotate timelines directly to track the rotation direction while
+// mixing, so they keep the spine-c layout and only lose the keyframes, returns the number of keyframes left
+static int reduceRotateTimeline(spTimeline* timeline, float tolerance)
+{
+    spBaseTimeline* rotateTimeline = SUB_CAST(spBaseTimeline, timeline);
+    int frameCount = rotateTimeline->framesCount / ROTATE_ENTRIES;
+
+    if (!rotateTimeline->frames || frameCount < 3) return frameCount;
+
+    std::vector<int> kept = findKeyframes(rotateTimeline->frames, rotateTimeline->super.curves, frameCount, ROTATE_ENTRIES, tolerance, true);
+    int keptCount = static_cast<int>(kept.size());
+
+    if (keptCount == frameCount) return frameCount;
+
+    float* frames = MALLOC(float, keptCount * ROTATE_ENTRIES);
+    // merged segments are all linear, CURVE_LINEAR is 0
+    float* curves = CALLOC(float, (keptCount - 1) * spine::CURVE_SIZE);
+
+    for (int k = 0; k < keptCount; ++k)
+    {
+        const float* frame = rotateTimeline->frames + kept[k] * ROTATE_ENTRIES;
+        std::copy(frame, frame + ROTATE_ENTRIES, frames + k * ROTATE_ENTRIES);
+
+        if (k + 1 < keptCount && kept[k + 1] == kept[k] + 1)
+        {
+            const float* curve = rotateTimeline->super.curves + kept[k] * spine::CURVE_SIZE;
+            std::copy(curve, curve + spine::CURVE_SIZE, curves + k * spine::CURVE_SIZE);
+        }
+    }
+
+    FREE(rotateTimeline->frames);
+    FREE(rotateTimeline->super.curves);
+    CONST_CAST(float*, rotateTimeline->frames) = frames;
+    CONST_CAST(int, rotateTimeline->framesCount) = keptCount * ROTATE_ENTRIES;
+    rotateTimeline->super.curves = curves;
+
+    return keptCount;
+}
+
+namespace spine
+{
+    std::unique_ptr<CompressedTimeline> CompressedTimeline::create(const spTimeline* timeline, const CompressionSettings& settings)
+    {
+        float tolerance;
+
+        switch (timeline->type)
+        {
+            case SP_TIMELINE_TRANSLATE:
+                tolerance = settings.translationTolerance;
+                break;
+            case SP_TIMELINE_SCALE:
+                tolerance = settings.scaleTolerance;
+                break;
+            case SP_TIMELINE_SHEAR:
+                tolerance = settings.rotationTolerance;
+                break;
+            default:
+                return nullptr;
+        }
+
+        const int entries = 3;
+        const int channels = entries - 1;
+        const spBaseTimeline* baseTimeline = reinterpret_cast<const spBaseTimeline*>(timeline);
+        const float* frames = baseTimeline->frames;
+        const float* curves = baseTimeline->super.curves;
+        int frameCount = baseTimeline->framesCount / entries;
+
+        if (!frames || frameCount < 2) return nullptr;
+
+        std::unique_ptr<CompressedTimeline> result(new CompressedTimeline());
+        result->entries = entries;
+
+        // values are rounded to the nearest step, which leaves the rest of the tolerance for removing keyframes
+        float quantizationError = 0.0f;
+
+        for (int c = 0; c < channels; ++c)
+        {
+            float minValue = frames[c + 1];
+            float maxValue = minValue;
+
+            for (int frame = 1; frame < frameCount; ++frame)
+            {
+                minValue = std::min(minValue, frames[frame * entries + c + 1]);
+                maxValue = std::max(maxValue, frames[frame * entries + c + 1]);
+            }
+
+            result->valueOffsets[c] = minValue;
+            result->valueScales[c] = (maxValue - minValue) / QUANTIZATION_STEPS;
+            quantizationError = std::max(quantizationError, result->valueScales[c] / 2.0f);
+        }
+
+        if (quantizationError >= tolerance) return nullptr;
+
+        std::vector<int> kept = findKeyframes(frames, curves, frameCount, entries, tolerance - quantizationError, false);
+
+        // times are not quantized, so the keyframes start exactly where the original ones did
+        for (int frame : kept)
+            result->times.push_back(frames[frame * entries]);
+
+        for (int frame : kept)
+        {
+            for (int c = 0; c < channels; ++c)
+            {
+                float value = frames[frame * entries + c + 1] - result->valueOffsets[c];
+                result->values.push_back(result->valueScales[c] > 0.0f ? static_cast<uint16_t>(std::round(value / result->valueScales[c])) : 0);
+            }
+        }
+
+        for (size_t k = 0; k + 1 < kept.size(); ++k)
+        {
+            // merged segments are all linear
+            if (kept[k + 1] != kept[k] + 1)
+            {
+                result->curves.push_back(CURVE_LINEAR);
+                continue;
+            }
+
+            const float* curve = curves + kept[k] * CURVE_SIZE;
+
+            if (curve[0] == CURVE_STEPPED)
+                result->curves.push_back(CURVE_STEPPED);
+            else if (curve[0] == CURVE_LINEAR)
+                result->curves.push_back(CURVE_LINEAR);
+            else
+            {
+                size_t index = result->beziers.size() / (CURVE_SIZE - 1);
+                if (index + CURVE_BEZIER > 0xFFFF) return nullptr;
+
+                result->curves.push_back(static_cast<uint16_t>(CURVE_BEZIER + index));
+                result->beziers.insert(result->beziers.end(), curve + 1, curve + CURVE_SIZE);
+            }
+        }
+
+        return result;
+    }
+
+    int CompressedTimeline::search(float time) const
+    {
+        int frameCount = getFrameCount();
+
+        if (frameCount < 3 || time < getTime(1)) return 0;
+        if (time >= getTime(frameCount - 2)) return frameCount - 2;
+
+        int low = 1;
+        int high = frameCount - 3;
+
+        while (low < high)
+        {
+            int middle = (low + high + 1) / 2;
+
+            if (getTime(middle) <= time)
+                low = middle;
+            else
+                high = middle - 1;
+        }
+
+        return low;
+    }
+
+    void CompressedTimeline::decode(int frame, float* frames, float* curve) const
+    {
+        int channels = entries - 1;
+
+        for (int i = 0; i < 2; ++i)
+        {
+            size_t index = static_cast<size_t>(frame + i);
+
+            frames[i * entries] = times[index];
+
+            for (int c = 0; c < channels; ++c)
+                frames[i * entries + c + 1] = valueOffsets[c] + values[index * static_cast<size_t>(channels) + static_cast<size_t>(c)] * valueScales[c];
+        }
+
+        uint16_t type = curves[static_cast<size_t>(frame)];
+
+        if (type >= CURVE_BEZIER)
+        {
+            curve[0] = CURVE_BEZIER;
+            std::copy(beziers.begin() + (type - CURVE_BEZIER) * (CURVE_SIZE - 1),
+                      beziers.begin() + (type - CURVE_BEZIER + 1) * (CURVE_SIZE - 1),
+                      curve + 1);
+        }
+        else
+            curve[0] = type;
+    }
+
+    uint64_t CompressedTimeline::getMemory() const
+    {
+        return sizeof(CompressedTimeline) +
+            times.capacity() * sizeof(float) +
+            values.capacity() * sizeof(uint16_t) +
+            curves.capacity() * sizeof(uint16_t) +
+            beziers.capacity() * sizeof(float);
+    }
+
+    CompressionReport compressAnimation(spSkeleton* skeleton, spAnimation* animation, const CompressionSettings& settings,
+                                        std::vector<std::unique_ptr<CompressedTimeline>>& compressedTimelines)
+    {
+        CompressionReport report;
+        report.animation = animation->name;
+        report.originalSize = getAnimationMemory(animation);
+
+        std::vector<float> originalPose;
+        samplePose(skeleton, animation, settings.sampleRate, originalPose);
+
+        for (int t = 0; t < animation->timelinesCount; ++t)
+        {
+            spTimeline* timeline = animation->timelines[t];
+            if (Sampler::getCompressedTimeline(timeline)) continue;
+
+            if (timeline->type == SP_TIMELINE_ROTATE)
+            {
+                report.originalKeyframes += static_cast<uint32_t>(SUB_CAST(spBaseTimeline, timeline)->framesCount / ROTATE_ENTRIES);
+                report.compressedKeyframes += static_cast<uint32_t>(reduceRotateTimeline(timeline, settings.rotationTolerance));
+                continue;
+            }
+
+            std::unique_ptr<CompressedTimeline> compressedTimeline = CompressedTimeline::create(timeline, settings);
+            if (!compressedTimeline) continue;
+
+            uint32_t keyframes = static_cast<uint32_t>(reinterpret_cast<const spBaseTimeline*>(timeline)->framesCount / compressedTimeline->getEntries());
+
+            if (Sampler::setCompressedTimeline(timeline, compressedTimeline.get()))
+            {
+                report.originalKeyframes += keyframes;
+                report.compressedKeyframes += static_cast<uint32_t>(compressedTimeline->getFrameCount());
+                compressedTimelines.push_back(std::move(compressedTimeline));
+            }
+        }
+
+        report.compressedSize = getAnimationMemory(animation);
+
+        std::vector<float> compressedPose;
+        samplePose(skeleton, animation, settings.sampleRate, compressedPose);
+
+        for (size_t i = 0; i + 2 < originalPose.size(); i += 3)
+        {
+            float x = compressedPose[i] - originalPose[i];
+            float y = compressedPose[i + 1] - originalPose[i + 1];
+
+            report.maxPositionError = std::max(report.maxPositionError, std::sqrt(x * x + y * y));
+            report.maxRotationError = std::max(report.maxRotationError, std::fabs(wrapRotation(compressedPose[i + 2] - originalPose[i + 2])));
+        }
+
+        spSkeleton_setToSetupPose(skeleton);
+
+        return report;
+    }
+}
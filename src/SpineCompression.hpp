@@ -0,0 +1,80 @@
+// Copyright (C) 2017 Elviss Strazdins
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct spTimeline;
+struct spAnimation;
+struct spSkeleton;
+
+namespace spine
+{
+    struct CompressionSettings
+    {
+        float rotationTolerance = 0.1f; // degrees, also used for shear
+        float translationTolerance = 0.1f; // skeleton units
+        float scaleTolerance = 0.001f;
+
+        // samples per second used to measure the pose error
+        float sampleRate = 60.0f;
+    };
+
+    struct CompressionReport
+    {
+        std::string animation;
+        uint64_t originalSize = 0;
+        uint64_t compressedSize = 0;
+        uint32_t originalKeyframes = 0;
+        uint32_t compressedKeyframes = 0;
+        // largest difference of bone world positions and local rotations between the original and the compressed animation
+        float maxPositionError = 0.0f;
+        float maxRotationError = 0.0f;
+    };
+
+    // Translate, scale or shear timeline with values quantized to 16 bits, linear keyframes that
+    // can be interpolated from their neighbours within the tolerance are removed. Keyframe times
+    // are kept as they are, so the compressed timeline matches the original at every keyframe
+    // it keeps to within the quantization step
+    class CompressedTimeline
+    {
+    public:
+        // returns nullptr if the timeline is not a translate, scale or shear timeline or can't be
+        // quantized within the tolerance
+        static std::unique_ptr<CompressedTimeline> create(const spTimeline* timeline, const CompressionSettings& settings);
+
+        int getEntries() const { return entries; }
+        int getFrameCount() const { return static_cast<int>(times.size()); }
+        float getTime(int frame) const { return times[static_cast<size_t>(frame)]; }
+
+        // index of the keyframe starting the segment that contains the time
+        int search(float time) const;
+
+        // writes the keyframes frame and frame + 1 in spine-c layout and the curve of the segment between them
+        void decode(int frame, float* frames, float* curve) const;
+
+        uint64_t getMemory() const;
+
+    private:
+        static const int MAX_CHANNELS = 2;
+
+        int entries = 0;
+        float valueOffsets[MAX_CHANNELS] = {};
+        float valueScales[MAX_CHANNELS] = {};
+
+        std::vector<float> times;
+        std::vector<uint16_t> values;
+        // per segment: LINEAR, STEPPED or BEZIER plus the index of the segment's samples in beziers
+        std::vector<uint16_t> curves;
+        std::vector<float> beziers;
+    };
+
+    // replaces the translate, scale and shear timelines of the animation with compressed ones and removes
+    // the keyframes of rotate timelines that linear interpolation can replace, rotate timelines keep the
+    // spine-c layout that spAnimationState reads while mixing, the skeleton is used to measure the pose error
+    CompressionReport compressAnimation(spSkeleton* skeleton, spAnimation* animation, const CompressionSettings& settings,
+                                        std::vector<std::unique_ptr<CompressedTimeline>>& compressedTimelines);
+}
@@ -0,0 +1,13 @@
+// Copyright (C) 2017 Elviss Strazdins
+
+#pragma once
+
+namespace spine
+{
+    // layout of spCurveTimeline::curves in spine-c, every segment between two keyframes has
+    // CURVE_SIZE floats: the curve type followed by the x and y of the bezier samples
+    static const int CURVE_SIZE = 19;
+    static const int CURVE_LINEAR = 0;
+    static const int CURVE_STEPPED = 1;
+    static const int CURVE_BEZIER = 2;
+}
@@ -0,0 +1,595 @@
+// Copyright (C) 2017 Elviss Strazdins
+
+#include <algorithm>
+#include <map>
+#include "SpineData.hpp"
+#include "SpineProfiler.hpp"
+#include "SpineSampler.hpp"
+#include "spine/spine.h"
+#include "spine/extension.h"
+
+struct SpineTexture
+{
+    std::shared_ptr<ouzel::graphics::Texture> texture;
+    std::string filename;
+    uint32_t pageIndex = 0;
+    spine::AtlasPageReport report;
+};
+
+void _spAtlasPage_createTexture(spAtlasPage* self, const char* path)
+{
+    SpineTexture* texture = new SpineTexture();
+    texture->filename = path;
+    texture->report.page = self->name;
+    texture->report.atlasFormat = spine::getAtlasFormatName(self);
+    self->rendererObject = texture;
+
+    spine::AtlasPageImage image;
+
+    if (!spine::loadAtlasPageImage(path, image))
+    {
+        ouzel::Log(ouzel::Log::Level::ERR) << "Failed to load atlas page " << path;
+        return;
+    }
+
+    spine::convertAtlasPageImage(self, image);
+
+    bool mipmaps = spine::hasAtlasPageMipmaps(self);
+
+    texture->texture = std::make_shared<ouzel::graphics::Texture>(*ouzel::engine->getRenderer());
+    texture->texture->init(image.data, ouzel::Size2(static_cast<float>(image.width), static_cast<float>(image.height)),
+                           0, mipmaps ? 0 : 1, image.pixelFormat);
+    texture->texture->setFilter(spine::getAtlasPageFilter(self));
+
+    self->width = static_cast<int>(image.width);
+    self->height = static_cast<int>(image.height);
+
+    spine::AtlasPageReport& report = texture->report;
+    report.filename = image.filename;
+    report.fileFormat = image.fileFormat;
+    report.pixelFormat = image.pixelFormat;
+    report.width = image.width;
+    report.height = image.height;
+    report.mipmaps = mipmaps;
+    report.memory = spine::getTextureMemory(image.width, image.height, image.pixelFormat, mipmaps);
+    report.fullMemory = spine::getTextureMemory(image.width, image.height, ouzel::graphics::PixelFormat::RGBA8_UNORM, true);
+}
+
+void _spAtlasPage_disposeTexture(spAtlasPage* self)
+{
+    delete static_cast<SpineTexture*>(self->rendererObject);
+}
+
+static spAtlasPage* getAttachmentPage(const spAttachment* attachment)
+{
+    if (!attachment) return nullptr;
+
+    switch (attachment->type)
+    {
+        case SP_ATTACHMENT_REGION:
+        {
+            const spRegionAttachment* regionAttachment = reinterpret_cast<const spRegionAttachment*>(attachment);
+            return regionAttachment->rendererObject ? static_cast<spAtlasRegion*>(regionAttachment->rendererObject)->page : nullptr;
+        }
+        case SP_ATTACHMENT_MESH:
+        case SP_ATTACHMENT_LINKED_MESH:
+        {
+            const spMeshAttachment* meshAttachment = reinterpret_cast<const spMeshAttachment*>(attachment);
+            return meshAttachment->rendererObject ? static_cast<spAtlasRegion*>(meshAttachment->rendererObject)->page : nullptr;
+        }
+        default:
+            return nullptr;
+    }
+}
+
+static void disposeComposedSkin(spSkin* skin)
+{
+    // the attachments belong to the source skins, so spSkin_dispose can't be used
+    _Entry* entry = SUB_CAST(_spSkin, skin)->entries;
+
+    while (entry)
+    {
+        _Entry* nextEntry = entry->next;
+        FREE(entry->name);
+        FREE(entry);
+        entry = nextEntry;
+    }
+
+    FREE(skin->name);
+    FREE(skin);
+}
+
+namespace spine
+{
+    const uint32_t SpineData::NO_ATTACHMENT;
+
+    std::shared_ptr<SpineData> SpineData::load(const std::string& atlasFile, const std::string& skeletonFile,
+                                               const LoadSettings& settings)
+    {
+        static std::map<std::pair<std::string, std::string>, std::weak_ptr<SpineData>> loadedData;
+
+        std::weak_ptr<SpineData>& cached = loadedData[std::make_pair(atlasFile, skeletonFile)];
+
+        std::shared_ptr<SpineData> data = cached.lock();
+
+        if (!data)
+        {
+            data = std::make_shared<SpineData>(atlasFile, skeletonFile, settings);
+            if (data->isLoaded()) cached = data;
+        }
+
+        return data;
+    }
+
+    SpineData::SpineData(const std::string& atlasFile, const std::string& skeletonFile, const LoadSettings& settings)
+    {
+        atlas = spAtlas_createFromFile(atlasFile.c_str(), 0);
+        if (!atlas)
+        {
+            ouzel::Log(ouzel::Log::Level::ERR) << "Failed to load atlas";
+            return;
+        }
+
+        if (skeletonFile.find(".json") != std::string::npos)
+        {
+            if (settings.lazyAnimations)
+                ouzel::Log(ouzel::Log::Level::WARN) << "Animations of json skeletons can't be loaded on demand, loading all of them";
+
+            // is json format
+            spSkeletonJson* json = spSkeletonJson_create(atlas);
+            skeletonData = spSkeletonJson_readSkeletonDataFile(json, skeletonFile.c_str());
+
+            if (!skeletonData)
+            {
+                ouzel::Log(ouzel::Log::Level::ERR) << "Failed to load skeleton: " << json->error;
+                return;
+            }
+            spSkeletonJson_dispose(json);
+        }
+        else
+        {
+            // binary format
+            spSkeletonBinary* binary = spSkeletonBinary_create(atlas);
+
+            if (settings.lazyAnimations)
+            {
+                std::vector<uint8_t> skeletonFileData;
+                animationLoader.reset(new AnimationLoader());
+
+                if (!animationLoader->init(ouzel::engine->getFileSystem().readFile(skeletonFile), skeletonFileData))
+                {
+                    ouzel::Log(ouzel::Log::Level::WARN) << "Animations of " << skeletonFile << " can't be loaded on demand, loading all of them";
+                    animationLoader.reset();
+                }
+                else
+                    skeletonData = spSkeletonBinary_readSkeletonData(binary, skeletonFileData.data(), static_cast<int>(skeletonFileData.size()));
+            }
+
+            if (!animationLoader)
+                skeletonData = spSkeletonBinary_readSkeletonDataFile(binary, skeletonFile.c_str());
+
+            if (!skeletonData)
+            {
+                ouzel::Log(ouzel::Log::Level::ERR) << "Failed to load skeleton: " << binary->error;
+                return;
+            }
+            spSkeletonBinary_dispose(binary);
+        }
+
+        for (spAtlasPage* page = atlas->pages; page; page = page->next)
+        {
+            if (SpineTexture* texture = static_cast<SpineTexture*>(page->rendererObject))
+                texture->pageIndex = static_cast<uint32_t>(pages.size());
+            pages.push_back(page);
+        }
+
+        for (int s = 0; s < skeletonData->skinsCount; ++s)
+        {
+            for (const _Entry* entry = SUB_CAST(_spSkin, skeletonData->skins[s])->entries; entry; entry = entry->next)
+            {
+                if (attachmentIndices.insert(std::make_pair(entry->attachment, static_cast<uint32_t>(attachments.size()))).second)
+                    attachments.push_back(entry->attachment);
+            }
+        }
+
+        timelineCount = Sampler::install(skeletonData);
+
+        if (animationLoader)
+        {
+            lazyAnimations.assign(animationLoader->getAnimationCount(), nullptr);
+
+            for (const std::string& name : settings.preloadAnimations)
+                if (!findAnimation(name))
+                    ouzel::Log(ouzel::Log::Level::WARN) << "Animation " << name << " not found";
+        }
+
+        shaders.push_back(ouzel::engine->getCache().getShader(ouzel::SHADER_TEXTURE));
+
+        updateSkeletonDataMemory();
+
+        for (const AtlasPageReport& report : getAtlasPageReports())
+            atlasPageMemory += report.memory;
+    }
+
+    SpineData::~SpineData()
+    {
+        poseCache.clear();
+        materials.clear();
+
+        for (const auto& composedSkin : composedSkins)
+            disposeComposedSkin(composedSkin.second);
+
+        if (skeletonData) spSkeletonData_dispose(skeletonData);
+        if (atlas) spAtlas_dispose(atlas);
+    }
+
+    uint32_t SpineData::getSortKey(const spSlot* slot) const
+    {
+        uint32_t pageIndex = NO_PAGE;
+
+        if (spAtlasPage* page = getAttachmentPage(slot->attachment))
+            if (SpineTexture* texture = static_cast<SpineTexture*>(page->rendererObject))
+                pageIndex = texture->pageIndex;
+
+        // only the texture shader is used for now
+        uint32_t shaderIndex = 0;
+
+        return (shaderIndex << SHADER_SHIFT) |
+            (static_cast<uint32_t>(slot->data->blendMode) << BLEND_MODE_SHIFT) |
+            pageIndex;
+    }
+
+    const std::shared_ptr<ouzel::graphics::Material>& SpineData::getMaterial(uint32_t sortKey)
+    {
+        std::shared_ptr<ouzel::graphics::Material>& material = materials[sortKey];
+
+        if (!material)
+        {
+            material = std::make_shared<ouzel::graphics::Material>();
+            material->shader = shaders[sortKey >> SHADER_SHIFT];
+            material->cullMode = ouzel::graphics::CullMode::NONE;
+
+            switch ((sortKey >> BLEND_MODE_SHIFT) & 0xFF)
+            {
+                case SP_BLEND_MODE_ADDITIVE:
+                    material->blendState = ouzel::engine->getCache().getBlendState(ouzel::BLEND_ADD);
+                    break;
+                case SP_BLEND_MODE_MULTIPLY:
+                    material->blendState = ouzel::engine->getCache().getBlendState(ouzel::BLEND_MULTIPLY);
+                    break;
+                case SP_BLEND_MODE_SCREEN:
+                    material->blendState = ouzel::engine->getCache().getBlendState(ouzel::BLEND_SCREEN);
+                    break;
+                case SP_BLEND_MODE_NORMAL:
+                default:
+                    material->blendState = ouzel::engine->getCache().getBlendState(ouzel::BLEND_ALPHA);
+            }
+
+            uint32_t pageIndex = sortKey & PAGE_MASK;
+
+            if (pageIndex < pages.size())
+                if (SpineTexture* texture = static_cast<SpineTexture*>(pages[pageIndex]->rendererObject))
+                    material->textures[0] = texture->texture;
+        }
+
+        return material;
+    }
+
+    spSkin* SpineData::getComposedSkin(const std::vector<std::string>& skinNames)
+    {
+        if (skinNames.size() == 1)
+        {
+            return spSkeletonData_findSkin(skeletonData, skinNames[0].c_str());
+        }
+
+        auto i = composedSkins.find(skinNames);
+        if (i != composedSkins.end()) return i->second;
+
+        std::string name;
+        std::vector<spSkin*> skins;
+
+        for (const std::string& skinName : skinNames)
+        {
+            spSkin* skin = spSkeletonData_findSkin(skeletonData, skinName.c_str());
+
+            if (!skin)
+            {
+                ouzel::Log(ouzel::Log::Level::ERR) << "Skin " << skinName << " not found";
+                return nullptr;
+            }
+
+            if (!name.empty()) name += "+";
+            name += skinName;
+            skins.push_back(skin);
+        }
+
+        spSkin* composedSkin = spSkin_create(name.c_str());
+
+        // spSkin_getAttachment returns the most recently added entry, so later skins win
+        for (spSkin* skin : skins)
+            for (const _Entry* entry = SUB_CAST(_spSkin, skin)->entries; entry; entry = entry->next)
+                spSkin_addAttachment(composedSkin, entry->slotIndex, entry->name, entry->attachment);
+
+        composedSkins[skinNames] = composedSkin;
+
+        return composedSkin;
+    }
+
+    std::vector<CompressionReport> SpineData::compressAnimations(const CompressionSettings& settings)
+    {
+        std::vector<CompressionReport> reports;
+
+        // compressing again would add the error of both passes
+        if (!isLoaded() || compressionSettings) return reports;
+
+        compressionSettings.reset(new CompressionSettings(settings));
+
+        spSkeleton* skeleton = spSkeleton_create(skeletonData);
+
+        for (int i = 0; i < skeletonData->animationsCount; ++i)
+            reports.push_back(compressAnimation(skeleton, skeletonData->animations[i], settings, compressedTimelines));
+
+        spSkeleton_dispose(skeleton);
+
+        // cached poses were evaluated from the uncompressed keyframes
+        poseCache.clear();
+        updateSkeletonDataMemory();
+
+        return reports;
+    }
+
+    std::vector<AtlasPageReport> SpineData::getAtlasPageReports() const
+    {
+        std::vector<AtlasPageReport> reports;
+
+        for (const spAtlasPage* page : pages)
+            if (const SpineTexture* texture = static_cast<const SpineTexture*>(page->rendererObject))
+                reports.push_back(texture->report);
+
+        return reports;
+    }
+
+    spAnimation* SpineData::findAnimation(const std::string& name)
+    {
+        if (!isLoaded()) return nullptr;
+
+        if (animationLoader)
+        {
+            size_t index = animationLoader->findAnimation(name);
+            return (index < lazyAnimations.size()) ? decodeAnimation(index) : nullptr;
+        }
+
+        return spSkeletonData_findAnimation(skeletonData, name.c_str());
+    }
+
+    bool SpineData::hasAnimation(const std::string& name) const
+    {
+        if (!isLoaded()) return false;
+
+        if (animationLoader) return animationLoader->findAnimation(name) < lazyAnimations.size();
+
+        return spSkeletonData_findAnimation(skeletonData, name.c_str()) != nullptr;
+    }
+
+    bool SpineData::isAnimationLoaded(const std::string& name) const
+    {
+        if (!isLoaded()) return false;
+
+        if (animationLoader)
+        {
+            size_t index = animationLoader->findAnimation(name);
+            return index < lazyAnimations.size() && lazyAnimations[index];
+        }
+
+        return spSkeletonData_findAnimation(skeletonData, name.c_str()) != nullptr;
+    }
+
+    bool SpineData::unloadAnimation(const std::string& name)
+    {
+        // animations loaded by spine-c stay loaded
+        if (!isLoaded() || !animationLoader) return false;
+
+        size_t index = animationLoader->findAnimation(name);
+        if (index >= lazyAnimations.size() || !lazyAnimations[index]) return false;
+
+        spAnimation* animation = lazyAnimations[index];
+        lazyAnimations[index] = nullptr;
+
+        spAnimation** end = std::remove(skeletonData->animations, skeletonData->animations + skeletonData->animationsCount, animation);
+        skeletonData->animationsCount = static_cast<int>(end - skeletonData->animations);
+
+        for (int t = 0; t < animation->timelinesCount; ++t)
+        {
+            if (const CompressedTimeline* compressedTimeline = Sampler::getCompressedTimeline(animation->timelines[t]))
+            {
+                compressedTimelines.erase(std::remove_if(compressedTimelines.begin(), compressedTimelines.end(),
+                                                         [compressedTimeline](const std::unique_ptr<CompressedTimeline>& i) {
+                                                             return i.get() == compressedTimeline;
+                                                         }), compressedTimelines.end());
+            }
+        }
+
+        // cached poses may point to the animation
+        poseCache.clear();
+        spAnimation_dispose(animation);
+
+        updateSkeletonDataMemory();
+
+        return true;
+    }
+
+    int32_t SpineData::getAnimationIndex(const spAnimation* animation) const
+    {
+        if (!isLoaded() || !animation) return -1;
+
+        if (animationLoader)
+        {
+            auto i = std::find(lazyAnimations.begin(), lazyAnimations.end(), animation);
+            return (i != lazyAnimations.end()) ? static_cast<int32_t>(i - lazyAnimations.begin()) : -1;
+        }
+
+        for (int i = 0; i < skeletonData->animationsCount; ++i)
+            if (skeletonData->animations[i] == animation) return i;
+
+        return -1;
+    }
+
+    spAnimation* SpineData::getAnimation(int32_t index)
+    {
+        if (index < 0 || index >= getAnimationCount()) return nullptr;
+
+        if (animationLoader) return decodeAnimation(static_cast<size_t>(index));
+
+        return skeletonData->animations[index];
+    }
+
+    bool SpineData::isAnimationLoaded(int32_t index) const
+    {
+        if (index < 0 || index >= getAnimationCount()) return false;
+
+        return animationLoader ? lazyAnimations[static_cast<size_t>(index)] != nullptr : true;
+    }
+
+    int32_t SpineData::getAnimationCount() const
+    {
+        if (!isLoaded()) return 0;
+
+        return animationLoader ? static_cast<int32_t>(lazyAnimations.size()) : skeletonData->animationsCount;
+    }
+
+    spAnimation* SpineData::decodeAnimation(size_t index)
+    {
+        if (lazyAnimations[index]) return lazyAnimations[index];
+
+        spAnimation* animation = animationLoader->readAnimation(index, skeletonData, 1.0f);
+
+        if (!animation)
+        {
+            ouzel::Log(ouzel::Log::Level::ERR) << "Failed to load animation " << animationLoader->getAnimationName(index);
+            return nullptr;
+        }
+
+        spAnimation** animations = MALLOC(spAnimation*, skeletonData->animationsCount + 1);
+        std::copy(skeletonData->animations, skeletonData->animations + skeletonData->animationsCount, animations);
+        animations[skeletonData->animationsCount] = animation;
+        FREE(skeletonData->animations);
+        skeletonData->animations = animations;
+        ++skeletonData->animationsCount;
+
+        // timeline indices are never reused, so samplers keep their cursors for the other timelines
+        timelineCount = Sampler::install(animation, timelineCount);
+        lazyAnimations[index] = animation;
+
+        if (compressionSettings)
+        {
+            spSkeleton* skeleton = spSkeleton_create(skeletonData);
+            compressAnimation(skeleton, animation, *compressionSettings, compressedTimelines);
+            spSkeleton_dispose(skeleton);
+        }
+
+        updateSkeletonDataMemory();
+
+        return animation;
+    }
+
+    void SpineData::updateSkeletonDataMemory()
+    {
+        skeletonDataMemory = spine::getSkeletonDataMemory(skeletonData);
+        if (animationLoader) skeletonDataMemory += animationLoader->getMemory();
+    }
+
+    std::vector<HullReport> SpineData::buildRegionHulls(const HullSettings& settings)
+    {
+        std::vector<HullReport> reports;
+
+        if (!isLoaded()) return reports;
+
+        std::map<const spAtlasRegion*, std::vector<float>> hulls;
+
+        for (spAtlasPage* page : pages)
+        {
+            HullReport report;
+            report.page = page->name;
+
+            SpineTexture* texture = static_cast<SpineTexture*>(page->rendererObject);
+            AtlasPageImage image;
+
+            // the texture may have been converted, so the pixels are read again as RGBA8
+            if (!texture || !loadAtlasPageImage(texture->filename, image))
+            {
+                ouzel::Log(ouzel::Log::Level::ERR) << "Failed to load atlas page " << page->name;
+                reports.push_back(report);
+                continue;
+            }
+
+            uint32_t pageWidth = image.width;
+            uint32_t pageHeight = image.height;
+            const uint8_t* pixels = image.data.data();
+
+            for (const spAtlasRegion* region = atlas->regions; region; region = region->next)
+            {
+                if (region->page != page) continue;
+
+                // rotated regions are stored turned by 90 degrees
+                int width = region->rotate ? region->height : region->width;
+                int height = region->rotate ? region->width : region->height;
+
+                if (region->x < 0 || region->y < 0 ||
+                    static_cast<uint32_t>(region->x + width) > pageWidth ||
+                    static_cast<uint32_t>(region->y + height) > pageHeight)
+                    continue;
+
+                uint64_t rectangleArea = static_cast<uint64_t>(width) * static_cast<uint64_t>(height);
+                std::vector<float> hull = computeHull(pixels, pageWidth, region->x, region->y, width, height, settings);
+                float hullArea = getPolygonArea(hull);
+
+                ++report.regionCount;
+                report.rectangleArea += rectangleArea;
+
+                // hulls that couldn't be reduced inside the rectangle are drawn as quads too
+                if (hull.size() < 6 || hull.size() / 2 > settings.maxVertices || hullArea > rectangleArea * settings.maxCoverage)
+                {
+                    report.hullArea += rectangleArea;
+                    continue;
+                }
+
+                ++report.hullCount;
+                report.hullArea += static_cast<uint64_t>(hullArea);
+                report.hullVertexCount += static_cast<uint32_t>(hull.size() / 2);
+
+                hulls[region] = std::move(hull);
+            }
+
+            reports.push_back(report);
+        }
+
+        regionMeshes.clear();
+
+        for (int s = 0; s < skeletonData->skinsCount; ++s)
+        {
+            for (const _Entry* entry = SUB_CAST(_spSkin, skeletonData->skins[s])->entries; entry; entry = entry->next)
+            {
+                if (entry->attachment->type != SP_ATTACHMENT_REGION) continue;
+
+                const spRegionAttachment* regionAttachment = reinterpret_cast<const spRegionAttachment*>(entry->attachment);
+                const spAtlasRegion* region = static_cast<const spAtlasRegion*>(regionAttachment->rendererObject);
+
+                auto hull = hulls.find(region);
+                if (hull == hulls.end()) continue;
+
+                RegionMesh regionMesh = createRegionMesh(regionAttachment, hull->second,
+                                                         static_cast<float>(region->page->width),
+                                                         static_cast<float>(region->page->height));
+
+                if (!regionMesh.triangles.empty())
+                    regionMeshes[entry->attachment] = std::move(regionMesh);
+            }
+        }
+
+        // cached poses were built with the old quads
+        poseCache.clear();
+        ++regionMeshVersion;
+
+        return reports;
+    }
+}
@@ -0,0 +1,147 @@
+// Copyright (C) 2017 Elviss Strazdins
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "SpineAnimationLoader.hpp"
+#include "SpineAtlasPage.hpp"
+#include "SpineCompression.hpp"
+#include "SpineHull.hpp"
+#include "SpinePoseCache.hpp"
+
+struct spSkeletonData;
+struct spAtlas;
+struct spAtlasPage;
+struct spSlot;
+struct spSkin;
+struct spAttachment;
+struct spAnimation;
+
+namespace spine
+{
+    struct LoadSettings
+    {
+        // decode the animations of binary skeletons only when they are first used
+        bool lazyAnimations = false;
+        // animations decoded while loading in lazy mode
+        std::vector<std::string> preloadAnimations;
+    };
+
+    // Atlas and skeleton data loaded from a pair of files, shared by all drawables created from them
+    class SpineData
+    {
+    public:
+        // the settings of the first load are used while the data stays loaded
+        static std::shared_ptr<SpineData> load(const std::string& atlasFile, const std::string& skeletonFile,
+                                               const LoadSettings& settings = LoadSettings());
+
+        SpineData(const std::string& atlasFile, const std::string& skeletonFile, const LoadSettings& settings = LoadSettings());
+        ~SpineData();
+
+        SpineData(const SpineData&) = delete;
+        SpineData& operator=(const SpineData&) = delete;
+
+        bool isLoaded() const { return atlas && skeletonData; }
+
+        spAtlas* getAtlas() const { return atlas; }
+        spSkeletonData* getSkeletonData() const { return skeletonData; }
+
+        uint32_t getTimelineCount() const { return timelineCount; }
+
+        // decodes the animation if it is not loaded yet, returns nullptr if there is no such animation
+        spAnimation* findAnimation(const std::string& name);
+        // doesn't decode the animation
+        bool hasAnimation(const std::string& name) const;
+        bool isAnimationLoaded(const std::string& name) const;
+        bool loadAnimation(const std::string& name) { return findAnimation(name) != nullptr; }
+        // releases a lazily loaded animation, it must not be used by any track or mix
+        bool unloadAnimation(const std::string& name);
+
+        // index that stays the same while animations are loaded and unloaded, -1 for unknown animations
+        int32_t getAnimationIndex(const spAnimation* animation) const;
+        // decodes the animation if it is not loaded yet
+        spAnimation* getAnimation(int32_t index);
+        bool isAnimationLoaded(int32_t index) const;
+        int32_t getAnimationCount() const;
+
+        // compresses the bone timelines of all animations, drawables sharing the data play the compressed ones,
+        // animations loaded on demand later are compressed as they are decoded, reports only cover the loaded ones,
+        // animations are only compressed once, later calls return no reports
+        std::vector<CompressionReport> compressAnimations(const CompressionSettings& settings = CompressionSettings());
+
+        // replaces the quads of region attachments with polygons around the covered pixels of the atlas pages,
+        // returns one report per page
+        std::vector<HullReport> buildRegionHulls(const HullSettings& settings = HullSettings());
+        const RegionMesh* getRegionMesh(const spAttachment* attachment) const
+        {
+            if (regionMeshes.empty()) return nullptr;
+            auto i = regionMeshes.find(attachment);
+            return (i == regionMeshes.end()) ? nullptr : &i->second;
+        }
+        // incremented every time the region meshes change
+        uint32_t getRegionMeshVersion() const { return regionMeshVersion; }
+
+        uint64_t getSkeletonDataMemory() const { return skeletonDataMemory; }
+        uint64_t getAtlasPageMemory() const { return atlasPageMemory; }
+        std::vector<AtlasPageReport> getAtlasPageReports() const;
+
+        // Sort keys identify the shader, blend mode and atlas page of a slot, equal keys mean equal materials
+        static const uint32_t SHADER_SHIFT = 24;
+        static const uint32_t BLEND_MODE_SHIFT = 16;
+        static const uint32_t PAGE_MASK = 0xFFFF;
+        static const uint32_t NO_PAGE = 0xFFFF;
+
+        uint32_t getSortKey(const spSlot* slot) const;
+        const std::shared_ptr<ouzel::graphics::Material>& getMaterial(uint32_t sortKey);
+        size_t getMaterialCount() const { return materials.size(); }
+
+        // skin made of the attachments of the given skins, later skins override earlier ones
+        spSkin* getComposedSkin(const std::vector<std::string>& skinNames);
+
+        // attachments of all skins by index, used to refer to attachments without pointers
+        static const uint32_t NO_ATTACHMENT = 0xFFFFFFFF;
+
+        uint32_t getAttachmentIndex(const spAttachment* attachment) const
+        {
+            auto i = attachmentIndices.find(attachment);
+            return (i == attachmentIndices.end()) ? NO_ATTACHMENT : i->second;
+        }
+        spAttachment* getAttachment(uint32_t index) const { return (index < attachments.size()) ? attachments[index] : nullptr; }
+        uint32_t getAttachmentCount() const { return static_cast<uint32_t>(attachments.size()); }
+
+        PoseCache& getPoseCache() { return poseCache; }
+        const PoseCache& getPoseCache() const { return poseCache; }
+
+    private:
+        spAnimation* decodeAnimation(size_t index);
+        void updateSkeletonDataMemory();
+
+        spAtlas* atlas = nullptr;
+        spSkeletonData* skeletonData = nullptr;
+        uint32_t timelineCount = 0;
+
+        uint64_t skeletonDataMemory = 0;
+        uint64_t atlasPageMemory = 0;
+
+        std::vector<spAtlasPage*> pages;
+        std::vector<std::shared_ptr<ouzel::graphics::Shader>> shaders;
+        std::map<uint32_t, std::shared_ptr<ouzel::graphics::Material>> materials;
+        std::map<std::vector<std::string>, spSkin*> composedSkins;
+        std::vector<std::unique_ptr<CompressedTimeline>> compressedTimelines;
+        std::unique_ptr<CompressionSettings> compressionSettings;
+        std::vector<spAttachment*> attachments;
+        std::unordered_map<const spAttachment*, uint32_t> attachmentIndices;
+        std::unordered_map<const spAttachment*, RegionMesh> regionMeshes;
+        uint32_t regionMeshVersion = 0;
+
+        PoseCache poseCache;
+
+        // animations of the loader by its index, nullptr for the ones that are not decoded
+        std::unique_ptr<AnimationLoader> animationLoader;
+        std::vector<spAnimation*> lazyAnimations;
+    };
+}
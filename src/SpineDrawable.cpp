@@ -1,29 +1,39 @@
 // Copyright (C) 2017 Elviss Strazdins
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 #include "SpineDrawable.hpp"
 #include "spine/spine.h"
 #include "spine/extension.h"
 
 static float worldVertices[SPINE_MESH_VERTEX_COUNT_MAX];
+static const uint16_t QUAD_TRIANGLES[] = {0, 1, 2, 0, 2, 3};
 
-struct SpineTexture
+// hull meshes that don't fit into worldVertices are drawn as quads
+static const spine::RegionMesh* getRegionMesh(const spine::SpineData& data, const spAttachment* attachment)
 {
-    std::shared_ptr<ouzel::graphics::Texture> texture;
-};
+    const spine::RegionMesh* regionMesh = data.getRegionMesh(attachment);
 
-void _spAtlasPage_createTexture(spAtlasPage* self, const char* path)
-{
-    SpineTexture* texture = new SpineTexture();
-
-    texture->texture = ouzel::engine->getCache().getTexture(path);
-    self->rendererObject = texture;
-    self->width = static_cast<int>(texture->texture->getSize().width);
-    self->height = static_cast<int>(texture->texture->getSize().height);
+    return (regionMesh && regionMesh->getVertexCount() * 2 <= SPINE_MESH_VERTEX_COUNT_MAX) ? regionMesh : nullptr;
 }
 
-void _spAtlasPage_disposeTexture(spAtlasPage* self)
+// region attachments with a hull mesh are drawn as polygons, the rest as quads
+static uint32_t computeRegionWorldVertices(spRegionAttachment* regionAttachment, spBone* bone, const spine::RegionMesh* regionMesh)
 {
-    delete static_cast<SpineTexture*>(self->rendererObject);
+    if (!regionMesh)
+    {
+        spRegionAttachment_computeWorldVertices(regionAttachment, bone, worldVertices, 0, 2);
+        return 4;
+    }
+
+    assert(regionMesh->getVertexCount() * 2 <= SPINE_MESH_VERTEX_COUNT_MAX);
+
+    float corners[8];
+    spRegionAttachment_computeWorldVertices(regionAttachment, bone, corners, 0, 2);
+    regionMesh->computeWorldVertices(corners, worldVertices);
+
+    return regionMesh->getVertexCount();
 }
 
 char* _spUtil_readFile(const char* path, int* length)
@@ -38,62 +48,16 @@ char* _spUtil_readFile(const char* path, int* length)
     return result;
 }
 
-static void listener(spAnimationState* state, spEventType type, spTrackEntry* entry, spEvent* event)
-{
-    static_cast<spine::SpineDrawable*>(state->rendererObject)->handleEvent(type, entry, event);
-}
-
 namespace spine
 {
-    SpineDrawable::SpineDrawable(const std::string& atlasFile, const std::string& skeletonFile):
-        Component(TYPE)
+    SpineDrawable::SpineDrawable(SpineWorld& initWorld, const std::string& atlasFile, const std::string& skeletonFile,
+                                 const LoadSettings& loadSettings):
+        Component(TYPE), world(&initWorld)
     {
-        atlas = spAtlas_createFromFile(atlasFile.c_str(), 0);
-        if (!atlas)
-        {
-            ouzel::Log(ouzel::Log::Level::ERR) << "Failed to load atlas";
-            return;
-        }
-
-        if (skeletonFile.find(".json") != std::string::npos)
-        {
-            // is json format
-            spSkeletonJson* json = spSkeletonJson_create(atlas);
-            skeletonData = spSkeletonJson_readSkeletonDataFile(json, skeletonFile.c_str());
-            
-            if (!skeletonData)
-            {
-                ouzel::Log(ouzel::Log::Level::ERR) << "Failed to load skeleton: " << json->error;
-                return;
-            }
-            spSkeletonJson_dispose(json);
-        }
-        else
-        {
-            // binary format
-            spSkeletonBinary* binary = spSkeletonBinary_create(atlas);
-            skeletonData = spSkeletonBinary_readSkeletonDataFile(binary, skeletonFile.c_str());
-            
-            if (!skeletonData)
-            {
-                ouzel::Log(ouzel::Log::Level::ERR) << "Failed to load skeleton: " << binary->error;
-                return;
-            }
-            spSkeletonBinary_dispose(binary);
-        }
+        handle = world->create(this, atlasFile, skeletonFile, loadSettings);
+        if (handle == SpineWorld::INVALID_HANDLE) return;
 
-        bounds = spSkeletonBounds_create();
-
-        skeleton = spSkeleton_create(skeletonData);
-
-        animationStateData = spAnimationStateData_create(skeletonData);
-        
-        animationState = spAnimationState_create(animationStateData);
-        animationState->listener = listener;
-        animationState->rendererObject = this;
-
-        spSkeleton_setToSetupPose(skeleton);
-        spSkeleton_updateWorldTransform(skeleton);
+        sampler.setTimelineCount(getData()->getTimelineCount());
 
         updateMaterials();
         updateBoundingBox();
@@ -105,31 +69,30 @@ namespace spine
         vertexBuffer->init(ouzel::graphics::Buffer::Usage::VERTEX, ouzel::graphics::Buffer::DYNAMIC);
 
         whitePixelTexture = ouzel::engine->getCache().getTexture(ouzel::TEXTURE_WHITE_PIXEL);
-
-        updateHandler.updateHandler = std::bind(&SpineDrawable::handleUpdate, this, std::placeholders::_1);
-        ouzel::engine->getEventDispatcher().addEventHandler(&updateHandler);
     }
 
     SpineDrawable::~SpineDrawable()
     {
-        if (bounds) spSkeletonBounds_dispose(bounds);
-        if (atlas) spAtlas_dispose(atlas);
-        if (animationState) spAnimationState_dispose(animationState);
-        if (animationStateData) spAnimationStateData_dispose(animationStateData);
-        if (skeleton) spSkeleton_dispose(skeleton);
-        if (skeletonData) spSkeletonData_dispose(skeletonData);
+        world->destroy(handle);
     }
 
-    bool SpineDrawable::handleUpdate(const ouzel::UpdateEvent& event)
+    const std::shared_ptr<SpineData>& SpineDrawable::getData() const
     {
-        update(event.delta);
-        return false;
+        static const std::shared_ptr<SpineData> noData;
+
+        return isValid() ? world->getData(handle) : noData;
+    }
+
+    const Stats& SpineDrawable::getStats() const
+    {
+        static const Stats noStats;
+
+        return isValid() ? world->getStats(handle) : noStats;
     }
 
     void SpineDrawable::update(float delta)
     {
-        spSkeleton_update(skeleton, delta);
-        spAnimationState_update(animationState, delta);
+        world->update(handle, delta);
     }
 
     void SpineDrawable::draw(const ouzel::Matrix4& transformMatrix,
@@ -142,123 +105,294 @@ namespace spine
                         renderViewProjection,
                         wireframe);
 
-        spAnimationState_apply(animationState, skeleton);
-        spSkeleton_updateWorldTransform(skeleton);
+        if (!isValid()) return;
+
+        Stats& stats = world->getStats(handle);
 
         std::vector<std::vector<float>> vertexShaderConstants(1);
 
         ouzel::Matrix4 modelViewProj = renderViewProjection * transformMatrix;
         vertexShaderConstants[0] = {std::begin(modelViewProj.m), std::end(modelViewProj.m)};
 
+        PoseCache::Key poseKey;
+
+        if (getPoseKey(poseKey))
+        {
+            PoseCache& poseCache = getData()->getPoseCache();
+            currentPose = poseCache.find(poseKey);
+
+            if (currentPose)
+            {
+                ++stats.poseHits;
+                skeletonOutdated = true;
+            }
+            else
+            {
+                ++stats.poseMisses;
+
+                // the pose gets its own buffers, so everything has to be built and uploaded
+                geometryValid = false;
+
+                applyAnimation();
+                buildGeometry();
+
+                currentPose = poseCache.create(poseKey);
+                currentPose->drawCommands = drawCommands;
+                currentPose->boundingBox = boundingBox;
+                currentPose->vertexCount = static_cast<uint32_t>(vertices.size());
+                currentPose->indexCount = static_cast<uint32_t>(indices.size());
+
+                uploadGeometry(*currentPose->indexBuffer, *currentPose->vertexBuffer);
+            }
+
+            boundingBox = currentPose->boundingBox;
+            world->setBoundingBox(handle, boundingBox);
+
+            // the own buffers of the drawable no longer match the skeleton
+            geometryValid = false;
+
+            submit(currentPose->drawCommands, *currentPose->indexBuffer, *currentPose->vertexBuffer,
+                   vertexShaderConstants, opacity, wireframe);
+        }
+        else
+        {
+            currentPose.reset();
+
+            applyAnimation();
+            buildGeometry();
+            uploadGeometry(*indexBuffer, *vertexBuffer);
+
+            submit(drawCommands, *indexBuffer, *vertexBuffer,
+                   vertexShaderConstants, opacity, wireframe);
+        }
+    }
+
+    spSkeleton* SpineDrawable::getSkeleton()
+    {
+        if (!isValid()) return nullptr;
+
+        // the caller can change anything, so the poses of other drawables no longer match this one
+        updateSkeleton();
+        skeletonModified = true;
+        currentPose.reset();
+
+        return world->getSkeleton(handle);
+    }
+
+    void SpineDrawable::setPoseSharing(bool newPoseSharing)
+    {
+        if (!isValid()) return;
+
+        uint32_t flags = world->getFlags(handle);
+        world->setFlags(handle, newPoseSharing ? (flags | SpineWorld::POSE_SHARING) : (flags & ~SpineWorld::POSE_SHARING));
+        if (!newPoseSharing) currentPose.reset();
+    }
+
+    bool SpineDrawable::isPoseSharing() const
+    {
+        if (!isValid()) return false;
+
+        return (world->getFlags(handle) & SpineWorld::POSE_SHARING) != 0;
+    }
+
+    void SpineDrawable::setPaused(bool newPaused)
+    {
+        if (!isValid()) return;
+
+        uint32_t flags = world->getFlags(handle);
+        world->setFlags(handle, newPaused ? (flags | SpineWorld::PAUSED) : (flags & ~SpineWorld::PAUSED));
+    }
+
+    bool SpineDrawable::isPaused() const
+    {
+        if (!isValid()) return false;
+
+        return (world->getFlags(handle) & SpineWorld::PAUSED) != 0;
+    }
+
+    void SpineDrawable::saveSnapshot(Snapshot& snapshot)
+    {
+        if (!isValid()) return;
+
+        updateSkeleton();
+        snapshot.capture(*getData(), world->getSkeleton(handle), getAnimationState());
+    }
+
+    bool SpineDrawable::restoreSnapshot(const Snapshot& snapshot)
+    {
+        if (!isValid()) return false;
+
+        spSkeleton* skeleton = world->getSkeleton(handle);
+
+        if (!snapshot.restore(*getData(), skeleton, getAnimationState()))
+        {
+            ouzel::Log(ouzel::Log::Level::ERR) << "Snapshot doesn't match the skeleton";
+            return false;
+        }
+
+        sampler.reset();
+        spSkeleton_updateWorldTransform(skeleton);
+
+        return true;
+    }
+
+    void SpineDrawable::setPoseSharingInterval(float newPoseSharingInterval)
+    {
+        poseSharingInterval = newPoseSharingInterval;
+    }
+
+    bool SpineDrawable::getPoseKey(PoseCache::Key& key) const
+    {
+        spSkeleton* skeleton = world->getSkeleton(handle);
+        spAnimationState* animationState = getAnimationState();
+
+        // events are fired by spAnimationState_apply, so only instances nobody listens to can skip it
+        if (!isPoseSharing() || skeletonModified || eventCallback || poseSharingInterval <= 0.0f) return false;
+        if (animationState->tracksCount < 1) return false;
+
+        for (int i = 1; i < animationState->tracksCount; ++i)
+            if (animationState->tracks[i]) return false;
+
+        spTrackEntry* current = animationState->tracks[0];
+
+        if (!current || current->delay > 0.0f || current->mixingFrom || current->alpha != 1.0f || current->listener) return false;
+
+        // spAnimationState_update starts a queued entry and removes an ending track from how far apply
+        // has played, so those frames are applied, the last one resets the skeleton to the setup pose
+        if (current->next || current->trackTime >= current->trackEnd) return false;
+
+        key.animation = current->animation;
+        key.skin = skeleton->skin;
+        key.frame = static_cast<int32_t>(std::floor(spTrackEntry_getAnimationTime(current) / poseSharingInterval));
+        key.flipX = skeleton->flipX != 0;
+        key.flipY = skeleton->flipY != 0;
+        key.x = skeleton->x;
+        key.y = skeleton->y;
+
+        return true;
+    }
+
+    void SpineDrawable::updateSkeleton()
+    {
+        if (isValid() && skeletonOutdated) applyAnimation();
+    }
+
+    void SpineDrawable::applyAnimation()
+    {
+        spSkeleton* skeleton = world->getSkeleton(handle);
+        Stats& stats = world->getStats(handle);
+        skeletonOutdated = false;
+
+        // animations loaded on demand add timelines
+        sampler.setTimelineCount(getData()->getTimelineCount());
+
+        {
+            Profiler::Scope scope(stats, Stats::APPLY, getProfilerId());
+            Sampler::Scope samplerScope(sampler);
+            spAnimationState_apply(getAnimationState(), skeleton);
+
+            stats.keyframeHits += static_cast<uint32_t>(sampler.getHits());
+            stats.keyframeSearches += static_cast<uint32_t>(sampler.getSearches());
+            sampler.resetCounters();
+        }
+
+        {
+            Profiler::Scope scope(stats, Stats::WORLD_TRANSFORM, getProfilerId());
+            spSkeleton_updateWorldTransform(skeleton);
+        }
+    }
+
+    void SpineDrawable::buildGeometry()
+    {
+        spSkeleton* skeleton = world->getSkeleton(handle);
+        Stats& stats = world->getStats(handle);
+
+        Profiler::Scope scope(stats, Stats::VERTEX_BUILD, getProfilerId());
+
+        updateChangedBones();
+
+        // while the draw order and the attachments stay the same only the slots that moved are rebuilt
+        if (geometryValid && !isTopologyChanged())
+        {
+            updateChangedSlots();
+            return;
+        }
+
         ouzel::graphics::Vertex vertex;
+        vertex.normal = ouzel::Vector3(0.0f, 0.0f, -1.0f);
 
         uint16_t currentVertexIndex = 0;
         indices.clear();
         vertices.clear();
+        drawCommands.clear();
 
-        uint32_t offset = 0;
-
-        boundingBox.reset();
-
-        struct DrawCommand
-        {
-            std::shared_ptr<ouzel::graphics::Material> material;
-            uint32_t indexCount;
-            uint32_t offset;
-            std::vector<std::vector<float>> pixelShaderConstants = std::vector<std::vector<float>>(1);
-        };
+        size_t slotCount = static_cast<size_t>(skeleton->slotsCount);
+        drawnSlots.resize(slotCount);
+        drawnAttachments.resize(slotCount);
+        slotVertexOffsets.assign(slotCount, 0);
+        slotVertexCounts.assign(slotCount, 0);
 
-        std::vector<DrawCommand> drawCommands;
+        uint32_t offset = 0;
 
         for (int i = 0; i < skeleton->slotsCount; ++i)
         {
             spSlot* slot = skeleton->drawOrder[i];
+            size_t slotIndex = static_cast<size_t>(slot->data->index);
+
+            drawnSlots[static_cast<size_t>(i)] = slot;
+            drawnAttachments[static_cast<size_t>(i)] = slot->attachment;
+            slotVertexOffsets[slotIndex] = static_cast<uint32_t>(vertices.size());
+
+            ouzel::Box3& slotBoundingBox = slotBoundingBoxes[slotIndex];
+            slotBoundingBox.reset();
+
             spAttachment* attachment = slot->attachment;
             if (!attachment) continue;
 
-            DrawCommand drawCommand;
-            drawCommand.material = materials[static_cast<size_t>(i)];
+            uint32_t sortKey = getData()->getSortKey(slot);
+
+            if (sortKeys[slotIndex] != sortKey)
+            {
+                sortKeys[slotIndex] = sortKey;
+                materials[slotIndex] = getData()->getMaterial(sortKey);
+            }
 
-            float colorVector[] = {slot->color.r * drawCommand.material->diffuseColor.normR(),
-                slot->color.g * drawCommand.material->diffuseColor.normG(),
-                slot->color.b * drawCommand.material->diffuseColor.normB(),
-                slot->color.a * drawCommand.material->diffuseColor.normA() * opacity};
-            drawCommand.pixelShaderConstants[0] = {std::begin(colorVector), std::end(colorVector)};
+            vertex.color.r = static_cast<uint8_t>(slot->color.r * 255.0f);
+            vertex.color.g = static_cast<uint8_t>(slot->color.g * 255.0f);
+            vertex.color.b = static_cast<uint8_t>(slot->color.b * 255.0f);
+            vertex.color.a = static_cast<uint8_t>(slot->color.a * 255.0f);
 
             if (attachment->type == SP_ATTACHMENT_REGION)
             {
                 spRegionAttachment* regionAttachment = reinterpret_cast<spRegionAttachment*>(attachment);
+                const RegionMesh* regionMesh = ::getRegionMesh(*getData(), attachment);
+
+                uint32_t vertexCount = computeRegionWorldVertices(regionAttachment, slot->bone, regionMesh);
+                const float* uvs = regionMesh ? regionMesh->uvs.data() : regionAttachment->uvs;
 
-                spRegionAttachment_computeWorldVertices(regionAttachment, slot->bone, worldVertices, 0, 2);
-
-                uint8_t r = static_cast<uint8_t>(skeleton->color.r * 255.0f);
-                uint8_t g = static_cast<uint8_t>(skeleton->color.g * 255.0f);
-                uint8_t b = static_cast<uint8_t>(skeleton->color.b * 255.0f);
-                uint8_t a = static_cast<uint8_t>(skeleton->color.a * 255.0f);
-
-                vertex.color.r = r;
-                vertex.color.g = g;
-                vertex.color.b = b;
-                vertex.color.a = a;
-                vertex.position.x = worldVertices[0];
-                vertex.position.y = worldVertices[1];
-                vertex.texCoords[0].x = regionAttachment->uvs[0];
-                vertex.texCoords[0].y = regionAttachment->uvs[1];
-                vertex.normal = ouzel::Vector3(0.0f, 0.0f, -1.0f);
-                vertices.push_back(vertex);
-
-                vertex.color.r = r;
-                vertex.color.g = g;
-                vertex.color.b = b;
-                vertex.color.a = a;
-                vertex.position.x = worldVertices[2];
-                vertex.position.y = worldVertices[3];
-                vertex.texCoords[0].x = regionAttachment->uvs[2];
-                vertex.texCoords[0].y = regionAttachment->uvs[3];
-                vertex.normal = ouzel::Vector3(0.0f, 0.0f, -1.0f);
-                vertices.push_back(vertex);
-
-                vertex.color.r = r;
-                vertex.color.g = g;
-                vertex.color.b = b;
-                vertex.color.a = a;
-                vertex.position.x = worldVertices[4];
-                vertex.position.y = worldVertices[5];
-                vertex.texCoords[0].x = regionAttachment->uvs[4];
-                vertex.texCoords[0].y = regionAttachment->uvs[5];
-                vertex.normal = ouzel::Vector3(0.0f, 0.0f, -1.0f);
-                vertices.push_back(vertex);
-
-                vertex.color.r = r;
-                vertex.color.g = g;
-                vertex.color.b = b;
-                vertex.color.a = a;
-                vertex.position.x = worldVertices[6];
-                vertex.position.y = worldVertices[7];
-                vertex.texCoords[0].x = regionAttachment->uvs[6];
-                vertex.texCoords[0].y = regionAttachment->uvs[7];
-                vertex.normal = ouzel::Vector3(0.0f, 0.0f, -1.0f);
-                vertices.push_back(vertex);
-
-                indices.push_back(currentVertexIndex + 0);
-                indices.push_back(currentVertexIndex + 1);
-                indices.push_back(currentVertexIndex + 2);
-                indices.push_back(currentVertexIndex + 0);
-                indices.push_back(currentVertexIndex + 2);
-                indices.push_back(currentVertexIndex + 3);
-
-                currentVertexIndex += 4;
-
-                boundingBox.insertPoint(ouzel::Vector3(worldVertices[0], worldVertices[1], 0.0F));
-                boundingBox.insertPoint(ouzel::Vector3(worldVertices[2], worldVertices[3], 0.0F));
-                boundingBox.insertPoint(ouzel::Vector3(worldVertices[4], worldVertices[5], 0.0F));
-                boundingBox.insertPoint(ouzel::Vector3(worldVertices[6], worldVertices[7], 0.0F));
-
-                if (!materials[static_cast<size_t>(i)]->textures[0])
+                for (uint32_t v = 0; v < vertexCount; ++v)
                 {
-                    SpineTexture* texture = static_cast<SpineTexture*>((static_cast<spAtlasRegion*>(regionAttachment->rendererObject))->page->rendererObject);
-                    if (texture) materials[static_cast<size_t>(i)]->textures[0] = texture->texture;
+                    vertex.position.x = worldVertices[v * 2];
+                    vertex.position.y = worldVertices[v * 2 + 1];
+                    vertex.texCoords[0].x = uvs[v * 2];
+                    vertex.texCoords[0].y = uvs[v * 2 + 1];
+                    vertices.push_back(vertex);
+
+                    slotBoundingBox.insertPoint(ouzel::Vector3(worldVertices[v * 2], worldVertices[v * 2 + 1], 0.0F));
                 }
+
+                if (regionMesh)
+                {
+                    for (uint16_t index : regionMesh->triangles)
+                        indices.push_back(currentVertexIndex + index);
+                }
+                else
+                {
+                    for (uint16_t index : QUAD_TRIANGLES)
+                        indices.push_back(currentVertexIndex + index);
+                }
+
+                currentVertexIndex = static_cast<uint16_t>(currentVertexIndex + vertexCount);
             }
             else if (attachment->type == SP_ATTACHMENT_MESH)
             {
@@ -266,11 +400,6 @@ namespace spine
                 if (meshAttachment->trianglesCount * 3 > SPINE_MESH_VERTEX_COUNT_MAX) continue;
                 spVertexAttachment_computeWorldVertices(SUPER(meshAttachment), slot, 0, meshAttachment->super.worldVerticesLength, worldVertices, 0, 2);
 
-                vertex.color.r = static_cast<uint8_t>(skeleton->color.r * 255.0f);
-                vertex.color.g = static_cast<uint8_t>(skeleton->color.g * 255.0f);
-                vertex.color.b = static_cast<uint8_t>(skeleton->color.b * 255.0f);
-                vertex.color.a = static_cast<uint8_t>(skeleton->color.a * 255.0f);
-
                 for (int t = 0; t < meshAttachment->trianglesCount; ++t)
                 {
                     int index = meshAttachment->triangles[t] << 1;
@@ -283,13 +412,7 @@ namespace spine
                     currentVertexIndex++;
                     vertices.push_back(vertex);
 
-                    boundingBox.insertPoint(ouzel::Vector3(worldVertices[index], worldVertices[index + 1], 0.0F));
-                }
-
-                if (!materials[static_cast<size_t>(i)]->textures[0])
-                {
-                    SpineTexture* texture = static_cast<SpineTexture*>((static_cast<spAtlasRegion*>(meshAttachment->rendererObject))->page->rendererObject);
-                    if (texture) materials[static_cast<size_t>(i)]->textures[0] = texture->texture;
+                    slotBoundingBox.insertPoint(ouzel::Vector3(worldVertices[index], worldVertices[index + 1], 0.0F));
                 }
             }
             else
@@ -297,74 +420,310 @@ namespace spine
                 continue;
             }
 
+            slotVertexCounts[slotIndex] = static_cast<uint32_t>(vertices.size()) - slotVertexOffsets[slotIndex];
+
             if (indices.size() - offset > 0)
             {
-                drawCommand.indexCount = static_cast<uint32_t>(indices.size()) - offset;
-                drawCommand.offset = offset;
-                drawCommands.push_back(drawCommand);
+                uint32_t indexCount = static_cast<uint32_t>(indices.size()) - offset;
+
+                // the slot color is in the vertices, so consecutive slots with the same material are merged
+                if (!drawCommands.empty() && drawCommands.back().sortKey == sortKey)
+                {
+                    drawCommands.back().indexCount += indexCount;
+                }
+                else
+                {
+                    DrawCommand drawCommand;
+                    drawCommand.material = materials[slotIndex];
+                    drawCommand.sortKey = sortKey;
+                    drawCommand.indexCount = indexCount;
+                    drawCommand.offset = offset;
+                    drawCommands.push_back(drawCommand);
+                }
             }
 
             offset = static_cast<uint32_t>(indices.size());
         }
 
-        indexBuffer->setData(indices.data(), static_cast<uint32_t>(ouzel::getVectorSize(indices)));
-        vertexBuffer->setData(vertices.data(), static_cast<uint32_t>(ouzel::getVectorSize(vertices)));
+        mergeSlotBoundingBoxes();
+
+        geometryValid = true;
+        regionMeshVersion = getData()->getRegionMeshVersion();
+        indicesChanged = true;
+        verticesChanged = true;
+
+        stats.vertexCount += static_cast<uint32_t>(vertices.size());
+        stats.indexCount += static_cast<uint32_t>(indices.size());
+    }
+
+    void SpineDrawable::updateChangedBones()
+    {
+        spSkeleton* skeleton = world->getSkeleton(handle);
+
+        size_t boneCount = static_cast<size_t>(skeleton->bonesCount);
+        boneTransforms.resize(boneCount * 6);
+        changedBones.resize(boneCount);
+
+        for (size_t i = 0; i < boneCount; ++i)
+        {
+            const spBone* bone = skeleton->bones[i];
+            float transform[6] = {bone->a, bone->b, bone->c, bone->d, bone->worldX, bone->worldY};
+            float* previousTransform = &boneTransforms[i * 6];
+
+            changedBones[i] = !std::equal(std::begin(transform), std::end(transform), previousTransform);
+            if (changedBones[i]) std::copy(std::begin(transform), std::end(transform), previousTransform);
+        }
+    }
+
+    bool SpineDrawable::isTopologyChanged() const
+    {
+        spSkeleton* skeleton = world->getSkeleton(handle);
+
+        if (drawnSlots.size() != static_cast<size_t>(skeleton->slotsCount)) return true;
+        if (regionMeshVersion != getData()->getRegionMeshVersion()) return true;
 
-        for (const DrawCommand& drawCommand : drawCommands)
+        for (int i = 0; i < skeleton->slotsCount; ++i)
         {
+            const spSlot* slot = skeleton->drawOrder[i];
+
+            if (drawnSlots[static_cast<size_t>(i)] != slot ||
+                drawnAttachments[static_cast<size_t>(i)] != slot->attachment)
+                return true;
+        }
+
+        return false;
+    }
+
+    bool SpineDrawable::isSlotChanged(const spSlot* slot, const ouzel::Color& color) const
+    {
+        const ouzel::Color& vertexColor = vertices[slotVertexOffsets[static_cast<size_t>(slot->data->index)]].color;
+
+        if (vertexColor.r != color.r || vertexColor.g != color.g ||
+            vertexColor.b != color.b || vertexColor.a != color.a)
+            return true;
+
+        if (changedBones[static_cast<size_t>(slot->bone->data->index)]) return true;
+
+        if (slot->attachment->type == SP_ATTACHMENT_MESH)
+        {
+            const spMeshAttachment* meshAttachment = reinterpret_cast<const spMeshAttachment*>(slot->attachment);
+
+            // deformed vertices are set by the animation every frame
+            if (slot->attachmentVerticesCount > 0) return true;
+
+            // weighted meshes store the vertex count followed by the bone indices for every vertex
+            const int* bones = meshAttachment->super.bones;
+            for (int b = 0; bones && b < meshAttachment->super.bonesCount;)
+            {
+                int count = bones[b++];
+
+                for (int n = 0; n < count; ++n)
+                    if (changedBones[static_cast<size_t>(bones[b++])]) return true;
+            }
+        }
+
+        return false;
+    }
+
+    void SpineDrawable::updateChangedSlots()
+    {
+        spSkeleton* skeleton = world->getSkeleton(handle);
+        Stats& stats = world->getStats(handle);
+
+        bool changed = false;
+
+        for (int i = 0; i < skeleton->slotsCount; ++i)
+        {
+            spSlot* slot = skeleton->drawOrder[i];
+            size_t slotIndex = static_cast<size_t>(slot->data->index);
+
+            uint32_t vertexOffset = slotVertexOffsets[slotIndex];
+            uint32_t vertexCount = slotVertexCounts[slotIndex];
+            if (vertexCount == 0) continue;
+
+            ouzel::Color color(static_cast<uint8_t>(slot->color.r * 255.0f),
+                               static_cast<uint8_t>(slot->color.g * 255.0f),
+                               static_cast<uint8_t>(slot->color.b * 255.0f),
+                               static_cast<uint8_t>(slot->color.a * 255.0f));
+
+            if (!isSlotChanged(slot, color))
+            {
+                ++stats.skippedSlotCount;
+                stats.skippedVertexCount += vertexCount;
+                continue;
+            }
+
+            ouzel::Box3& slotBoundingBox = slotBoundingBoxes[slotIndex];
+            slotBoundingBox.reset();
+
+            ouzel::graphics::Vertex* vertex = vertices.data() + vertexOffset;
+
+            if (slot->attachment->type == SP_ATTACHMENT_REGION)
+            {
+                spRegionAttachment* regionAttachment = reinterpret_cast<spRegionAttachment*>(slot->attachment);
+                computeRegionWorldVertices(regionAttachment, slot->bone, ::getRegionMesh(*getData(), slot->attachment));
+
+                for (uint32_t v = 0; v < vertexCount; ++v, ++vertex)
+                {
+                    vertex->position.x = worldVertices[v * 2];
+                    vertex->position.y = worldVertices[v * 2 + 1];
+                    vertex->color = color;
+
+                    slotBoundingBox.insertPoint(ouzel::Vector3(worldVertices[v * 2], worldVertices[v * 2 + 1], 0.0F));
+                }
+            }
+            else
+            {
+                spMeshAttachment* meshAttachment = reinterpret_cast<spMeshAttachment*>(slot->attachment);
+                spVertexAttachment_computeWorldVertices(SUPER(meshAttachment), slot, 0, meshAttachment->super.worldVerticesLength, worldVertices, 0, 2);
+
+                for (int t = 0; t < meshAttachment->trianglesCount; ++t, ++vertex)
+                {
+                    int index = meshAttachment->triangles[t] << 1;
+                    vertex->position.x = worldVertices[index];
+                    vertex->position.y = worldVertices[index + 1];
+                    vertex->color = color;
+
+                    slotBoundingBox.insertPoint(ouzel::Vector3(worldVertices[index], worldVertices[index + 1], 0.0F));
+                }
+            }
+
+            changed = true;
+        }
+
+        if (changed)
+        {
+            mergeSlotBoundingBoxes();
+            verticesChanged = true;
+        }
+
+        stats.vertexCount += static_cast<uint32_t>(vertices.size());
+        stats.indexCount += static_cast<uint32_t>(indices.size());
+    }
+
+    void SpineDrawable::uploadGeometry(ouzel::graphics::Buffer& targetIndexBuffer,
+                                       ouzel::graphics::Buffer& targetVertexBuffer)
+    {
+        Stats& stats = world->getStats(handle);
+
+        {
+            Profiler::Scope scope(stats, Stats::UPLOAD, getProfilerId());
+
+            if (indicesChanged)
+            {
+                targetIndexBuffer.setData(indices.data(), static_cast<uint32_t>(ouzel::getVectorSize(indices)));
+                stats.uploadedBytes += ouzel::getVectorSize(indices);
+                indicesChanged = false;
+            }
+
+            // Buffer::setData can only replace the whole buffer, so any changed slot uploads all vertices
+            if (verticesChanged)
+            {
+                targetVertexBuffer.setData(vertices.data(), static_cast<uint32_t>(ouzel::getVectorSize(vertices)));
+                stats.uploadedBytes += ouzel::getVectorSize(vertices);
+                verticesChanged = false;
+            }
+        }
+
+        // CPU side storage plus the GPU copy of the last upload
+        stats.bufferMemory = indices.capacity() * sizeof(uint16_t) + vertices.capacity() * sizeof(ouzel::graphics::Vertex) +
+            ouzel::getVectorSize(indices) + ouzel::getVectorSize(vertices);
+    }
+
+    void SpineDrawable::submit(const std::vector<DrawCommand>& commands,
+                               ouzel::graphics::Buffer& sourceIndexBuffer,
+                               ouzel::graphics::Buffer& sourceVertexBuffer,
+                               const std::vector<std::vector<float>>& vertexShaderConstants,
+                               float opacity,
+                               bool wireframe)
+    {
+        spSkeleton* skeleton = world->getSkeleton(handle);
+        Stats& stats = world->getStats(handle);
+
+        Profiler::Scope scope(stats, Stats::SUBMIT, getProfilerId());
+
+        for (const DrawCommand& drawCommand : commands)
+        {
+            const std::shared_ptr<ouzel::graphics::Material>& material = drawCommand.material;
+
+            std::vector<std::vector<float>> pixelShaderConstants(1);
+
+            float colorVector[] = {skeleton->color.r * material->diffuseColor.normR(),
+                skeleton->color.g * material->diffuseColor.normG(),
+                skeleton->color.b * material->diffuseColor.normB(),
+                skeleton->color.a * material->diffuseColor.normA() * opacity};
+            pixelShaderConstants[0] = {std::begin(colorVector), std::end(colorVector)};
+
             std::vector<uintptr_t> textures;
             if (wireframe) textures.push_back(whitePixelTexture->getResource());
             else
-                for (const auto& texture : drawCommand.material->textures)
+                for (const auto& texture : material->textures)
                     textures.push_back(texture ? texture->getResource() : 0);
 
-            ouzel::engine->getRenderer()->setCullMode(drawCommand.material->cullMode);
-            ouzel::engine->getRenderer()->setPipelineState(drawCommand.material->blendState->getResource(),
-                                                           drawCommand.material->shader->getResource());
-            ouzel::engine->getRenderer()->setShaderConstants(drawCommand.pixelShaderConstants,
+            ouzel::engine->getRenderer()->setCullMode(material->cullMode);
+            ouzel::engine->getRenderer()->setPipelineState(material->blendState->getResource(),
+                                                           material->shader->getResource());
+            ouzel::engine->getRenderer()->setShaderConstants(pixelShaderConstants,
                                                              vertexShaderConstants);
             ouzel::engine->getRenderer()->setTextures(textures);
-            ouzel::engine->getRenderer()->draw(indexBuffer->getResource(),
+            ouzel::engine->getRenderer()->draw(sourceIndexBuffer.getResource(),
                                                drawCommand.indexCount,
                                                sizeof(uint16_t),
-                                               vertexBuffer->getResource(),
+                                               sourceVertexBuffer.getResource(),
                                                ouzel::graphics::DrawMode::TRIANGLE_LIST,
                                                drawCommand.offset);
+            ++stats.drawCallCount;
         }
     }
 
     float SpineDrawable::getTimeScale() const
     {
-        return animationState->timeScale;
+        if (!isValid()) return 1.0f;
+
+        return getAnimationState()->timeScale;
     }
 
     void SpineDrawable::setTimeScale(float newTimeScale)
     {
-        animationState->timeScale = newTimeScale;
+        if (!isValid()) return;
+
+        getAnimationState()->timeScale = newTimeScale;
     }
 
     void SpineDrawable::setFlipX(bool flipX)
     {
-        skeleton->flipX = flipX;
+        if (!isValid()) return;
+
+        world->getSkeleton(handle)->flipX = flipX;
     }
 
     bool SpineDrawable::getFlipX() const
     {
-        return skeleton->flipX != 0;
+        if (!isValid()) return false;
+
+        return world->getSkeleton(handle)->flipX != 0;
     }
 
     void SpineDrawable::setFlipY(bool flipY)
     {
-        skeleton->flipY = flipY;
+        if (!isValid()) return;
+
+        world->getSkeleton(handle)->flipY = flipY;
     }
 
     bool SpineDrawable::getFlipY() const
     {
-        return skeleton->flipY != 0;
+        if (!isValid()) return false;
+
+        return world->getSkeleton(handle)->flipY != 0;
     }
 
     void SpineDrawable::setOffset(const ouzel::Vector2& offset)
     {
+        if (!isValid()) return;
+
+        spSkeleton* skeleton = world->getSkeleton(handle);
+
         skeleton->x = offset.x;
         skeleton->y = offset.y;
 
@@ -373,34 +732,47 @@ namespace spine
 
     ouzel::Vector2 SpineDrawable::getOffset()
     {
+        if (!isValid()) return ouzel::Vector2();
+
+        spSkeleton* skeleton = world->getSkeleton(handle);
+
         return ouzel::Vector2(skeleton->x, skeleton->y);
     }
 
     void SpineDrawable::reset()
     {
-        spSkeleton_setToSetupPose(skeleton);
+        if (!isValid()) return;
+
+        spSkeleton_setToSetupPose(world->getSkeleton(handle));
+        skeletonModified = false;
     }
 
     void SpineDrawable::clearTracks()
     {
-        spAnimationState_clearTracks(animationState);
+        if (!isValid()) return;
+
+        spAnimationState_clearTracks(getAnimationState());
     }
 
     void SpineDrawable::clearTrack(int32_t trackIndex)
     {
-        spAnimationState_clearTrack(animationState, trackIndex);
+        if (!isValid()) return;
+
+        spAnimationState_clearTrack(getAnimationState(), trackIndex);
     }
 
     bool SpineDrawable::hasAnimation(const std::string& animationName)
     {
-        spAnimation* animation = spSkeletonData_findAnimation(animationState->data->skeletonData, animationName.c_str());
+        if (!isValid()) return false;
 
-        return animation != nullptr;
+        return getData()->hasAnimation(animationName);
     }
 
     std::string SpineDrawable::getAnimation(int32_t trackIndex) const
     {
-        spTrackEntry* track = spAnimationState_getCurrent(animationState, trackIndex);
+        if (!isValid()) return std::string();
+
+        spTrackEntry* track = spAnimationState_getCurrent(getAnimationState(), trackIndex);
 
         if (track && track->animation)
         {
@@ -412,7 +784,11 @@ namespace spine
 
     bool SpineDrawable::setAnimation(int32_t trackIndex, const std::string& animationName, bool loop)
     {
-        spAnimation* animation = spSkeletonData_findAnimation(animationState->data->skeletonData, animationName.c_str());
+        if (!isValid()) return false;
+
+        spAnimationState* animationState = getAnimationState();
+
+        spAnimation* animation = getData()->findAnimation(animationName);
 
         if (!animation)
         {
@@ -426,7 +802,11 @@ namespace spine
 
     bool SpineDrawable::addAnimation(int32_t trackIndex, const std::string& animationName, bool loop, float delay)
     {
-        spAnimation* animation = spSkeletonData_findAnimation(animationState->data->skeletonData, animationName.c_str());
+        if (!isValid()) return false;
+
+        spAnimationState* animationState = getAnimationState();
+
+        spAnimation* animation = getData()->findAnimation(animationName);
 
         if (!animation)
         {
@@ -440,30 +820,35 @@ namespace spine
 
     bool SpineDrawable::setAnimationMix(const std::string& from, const std::string& to, float duration)
     {
-        spAnimation* animationFrom = spSkeletonData_findAnimation(animationState->data->skeletonData, from.c_str());
+        if (!isValid()) return false;
+
+        spAnimation* animationFrom = getData()->findAnimation(from);
 
         if (!animationFrom)
         {
             return false;
         }
 
-        spAnimation* animationTo = spSkeletonData_findAnimation(animationState->data->skeletonData, to.c_str());
+        spAnimation* animationTo = getData()->findAnimation(to);
 
         if (!animationTo)
         {
             return false;
         }
 
-        spAnimationStateData_setMix(animationStateData, animationFrom, animationTo, duration);
+        spAnimationStateData_setMix(world->getAnimationStateData(handle), animationFrom, animationTo, duration);
 
         return true;
     }
 
     bool SpineDrawable::setAnimationProgress(int32_t trackIndex, float progress)
     {
-        if (spTrackEntry* current = spAnimationState_getCurrent(animationState, trackIndex))
+        if (!isValid()) return false;
+
+        if (spTrackEntry* current = spAnimationState_getCurrent(getAnimationState(), trackIndex))
         {
             current->trackTime = current->trackEnd * progress;
+            sampler.reset();
         }
 
         return true;
@@ -471,7 +856,9 @@ namespace spine
 
     float SpineDrawable::getAnimationProgress(int32_t trackIndex) const
     {
-        if (spTrackEntry* current = spAnimationState_getCurrent(animationState, trackIndex))
+        if (!isValid()) return 0.0f;
+
+        if (spTrackEntry* current = spAnimationState_getCurrent(getAnimationState(), trackIndex))
         {
             return (current->trackEnd != 0.0f) ? current->trackTime / current->trackEnd : 0.0f;
         }
@@ -481,7 +868,9 @@ namespace spine
 
     std::string SpineDrawable::getAnimationName(int32_t trackIndex) const
     {
-        if (spTrackEntry* current = spAnimationState_getCurrent(animationState, trackIndex))
+        if (!isValid()) return std::string();
+
+        if (spTrackEntry* current = spAnimationState_getCurrent(getAnimationState(), trackIndex))
         {
             if (current->animation) return current->animation->name;
         }
@@ -530,100 +919,141 @@ namespace spine
 
     void SpineDrawable::setSkin(const std::string& skinName)
     {
-        spSkin* skin = spSkeletonData_findSkin(skeletonData, skinName.c_str());
-        spSkeleton_setSkin(skeleton, skin);
+        if (!isValid()) return;
 
-        updateMaterials();
-        updateBoundingBox();
+        spSkin* skin = spSkeletonData_findSkin(getData()->getSkeletonData(), skinName.c_str());
+        applySkin(skin);
     }
 
-    void SpineDrawable::updateBoundingBox()
+    bool SpineDrawable::setSkins(const std::vector<std::string>& skinNames)
     {
-        boundingBox.reset();
+        if (!isValid()) return false;
 
-        for (int i = 0; i < skeleton->slotsCount; ++i)
+        spSkin* skin = getData()->getComposedSkin(skinNames);
+
+        if (!skin)
         {
-            spSlot* slot = skeleton->drawOrder[i];
-            spAttachment* attachment = slot->attachment;
+            return false;
+        }
 
-            if (attachment)
-            {
-                if (attachment->type == SP_ATTACHMENT_REGION)
-                {
-                    spRegionAttachment* regionAttachment = reinterpret_cast<spRegionAttachment*>(attachment);
-                    spRegionAttachment_computeWorldVertices(regionAttachment, slot->bone, worldVertices, 0, 2);
+        applySkin(skin);
 
-                    boundingBox.insertPoint(ouzel::Vector3(worldVertices[0], worldVertices[1], 0.0F));
-                    boundingBox.insertPoint(ouzel::Vector3(worldVertices[2], worldVertices[3], 0.0F));
-                    boundingBox.insertPoint(ouzel::Vector3(worldVertices[4], worldVertices[5], 0.0F));
-                    boundingBox.insertPoint(ouzel::Vector3(worldVertices[6], worldVertices[7], 0.0F));
-                }
-                else if (attachment->type == SP_ATTACHMENT_MESH)
-                {
-                    spMeshAttachment* meshAttachment = reinterpret_cast<spMeshAttachment*>(attachment);
-                    if (meshAttachment->trianglesCount * 3 > SPINE_MESH_VERTEX_COUNT_MAX) continue;
-                    spVertexAttachment_computeWorldVertices(SUPER(meshAttachment), slot, 0, meshAttachment->super.worldVerticesLength, worldVertices, 0, 2);
+        return true;
+    }
 
-                    for (int t = 0; t < meshAttachment->trianglesCount; ++t)
-                    {
-                        int index = meshAttachment->triangles[t] << 1;
+    std::string SpineDrawable::getSkin() const
+    {
+        if (!isValid()) return std::string();
 
-                        boundingBox.insertPoint(ouzel::Vector3(worldVertices[index], worldVertices[index + 1], 0.0F));
-                    }
-                }
-            }
-        }
+        spSkeleton* skeleton = world->getSkeleton(handle);
+
+        return skeleton->skin ? skeleton->skin->name : std::string();
     }
 
-    void SpineDrawable::updateMaterials()
+    void SpineDrawable::applySkin(spSkin* skin)
     {
-        materials.clear();
-        materials.resize(static_cast<size_t>(skeleton->slotsCount));
+        spSkeleton* skeleton = world->getSkeleton(handle);
+
+        slotAttachments.resize(static_cast<size_t>(skeleton->slotsCount));
 
         for (int i = 0; i < skeleton->slotsCount; ++i)
-        {
-            std::shared_ptr<ouzel::graphics::Material>& material = materials[static_cast<size_t>(i)];
-            material = std::make_shared<ouzel::graphics::Material>();
-            material->shader = ouzel::engine->getCache().getShader(ouzel::SHADER_TEXTURE);
-            material->cullMode = ouzel::graphics::CullMode::NONE;
+            slotAttachments[static_cast<size_t>(i)] = skeleton->slots[i]->attachment;
 
-            spSlot* slot = skeleton->drawOrder[i];
+        spSkeleton_setSkin(skeleton, skin);
+
+        // only slots whose attachment was replaced need new materials and bounds
+        bool changed = false;
+
+        for (int i = 0; i < skeleton->slotsCount; ++i)
+        {
+            spSlot* slot = skeleton->slots[i];
 
-            switch (slot->data->blendMode)
+            if (slot->attachment != slotAttachments[static_cast<size_t>(i)])
             {
-                case SP_BLEND_MODE_ADDITIVE:
-                    material->blendState = ouzel::engine->getCache().getBlendState(ouzel::BLEND_ADD);
-                    break;
-                case SP_BLEND_MODE_MULTIPLY:
-                    material->blendState = ouzel::engine->getCache().getBlendState(ouzel::BLEND_MULTIPLY);
-                    break;
-                case SP_BLEND_MODE_SCREEN:
-                    material->blendState = ouzel::engine->getCache().getBlendState(ouzel::BLEND_SCREEN);
-                    break;
-                case SP_BLEND_MODE_NORMAL:
-                default:
-                    material->blendState = ouzel::engine->getCache().getBlendState(ouzel::BLEND_ALPHA);
+                sortKeys[static_cast<size_t>(i)] = getData()->getSortKey(slot);
+                materials[static_cast<size_t>(i)] = getData()->getMaterial(sortKeys[static_cast<size_t>(i)]);
+                updateSlotBoundingBox(slot);
+                changed = true;
             }
+        }
+
+        if (changed) mergeSlotBoundingBoxes();
+    }
+
+    void SpineDrawable::updateBoundingBox()
+    {
+        spSkeleton* skeleton = world->getSkeleton(handle);
 
+        slotBoundingBoxes.resize(static_cast<size_t>(skeleton->slotsCount));
 
-            spAttachment* attachment = slot->attachment;
+        for (int i = 0; i < skeleton->slotsCount; ++i)
+            updateSlotBoundingBox(skeleton->slots[i]);
 
-            if (attachment)
+        mergeSlotBoundingBoxes();
+    }
+
+    void SpineDrawable::updateSlotBoundingBox(spSlot* slot)
+    {
+        ouzel::Box3& slotBoundingBox = slotBoundingBoxes[static_cast<size_t>(slot->data->index)];
+        slotBoundingBox.reset();
+
+        spAttachment* attachment = slot->attachment;
+
+        if (attachment)
+        {
+            if (attachment->type == SP_ATTACHMENT_REGION)
             {
-                if (attachment->type == SP_ATTACHMENT_REGION)
-                {
-                    spRegionAttachment* regionAttachment = reinterpret_cast<spRegionAttachment*>(attachment);
-                    SpineTexture* texture = static_cast<SpineTexture*>((static_cast<spAtlasRegion*>(regionAttachment->rendererObject))->page->rendererObject);
-                    if (texture) material->textures[0] = texture->texture;
-                }
-                else if (attachment->type == SP_ATTACHMENT_MESH)
+                spRegionAttachment* regionAttachment = reinterpret_cast<spRegionAttachment*>(attachment);
+                uint32_t vertexCount = computeRegionWorldVertices(regionAttachment, slot->bone, ::getRegionMesh(*getData(), attachment));
+
+                for (uint32_t v = 0; v < vertexCount; ++v)
+                    slotBoundingBox.insertPoint(ouzel::Vector3(worldVertices[v * 2], worldVertices[v * 2 + 1], 0.0F));
+            }
+            else if (attachment->type == SP_ATTACHMENT_MESH)
+            {
+                spMeshAttachment* meshAttachment = reinterpret_cast<spMeshAttachment*>(attachment);
+                if (meshAttachment->trianglesCount * 3 > SPINE_MESH_VERTEX_COUNT_MAX) return;
+                spVertexAttachment_computeWorldVertices(SUPER(meshAttachment), slot, 0, meshAttachment->super.worldVerticesLength, worldVertices, 0, 2);
+
+                for (int t = 0; t < meshAttachment->trianglesCount; ++t)
                 {
-                    spMeshAttachment* meshAttachment = reinterpret_cast<spMeshAttachment*>(attachment);
-                    SpineTexture* texture = static_cast<SpineTexture*>((static_cast<spAtlasRegion*>(meshAttachment->rendererObject))->page->rendererObject);
-                    if (texture) material->textures[0] = texture->texture;
+                    int index = meshAttachment->triangles[t] << 1;
+
+                    slotBoundingBox.insertPoint(ouzel::Vector3(worldVertices[index], worldVertices[index + 1], 0.0F));
                 }
             }
         }
+    }
+
+    void SpineDrawable::mergeSlotBoundingBoxes()
+    {
+        boundingBox.reset();
+
+        for (const ouzel::Box3& slotBoundingBox : slotBoundingBoxes)
+        {
+            // skip slots without any geometry
+            if (slotBoundingBox.min.x > slotBoundingBox.max.x) continue;
+
+            boundingBox.insertPoint(slotBoundingBox.min);
+            boundingBox.insertPoint(slotBoundingBox.max);
+        }
 
+        world->setBoundingBox(handle, boundingBox);
+    }
+
+    void SpineDrawable::updateMaterials()
+    {
+        spSkeleton* skeleton = world->getSkeleton(handle);
+
+        materials.resize(static_cast<size_t>(skeleton->slotsCount));
+        sortKeys.resize(static_cast<size_t>(skeleton->slotsCount));
+
+        for (int i = 0; i < skeleton->slotsCount; ++i)
+        {
+            spSlot* slot = skeleton->slots[i];
+
+            sortKeys[static_cast<size_t>(i)] = getData()->getSortKey(slot);
+            materials[static_cast<size_t>(i)] = getData()->getMaterial(sortKeys[static_cast<size_t>(i)]);
+        }
     }
 }
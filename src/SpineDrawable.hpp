@@ -6,6 +6,11 @@
 #include <memory>
 #include <vector>
 #include "ouzel.hpp"
+#include "SpineData.hpp"
+#include "SpineProfiler.hpp"
+#include "SpineSampler.hpp"
+#include "SpineSnapshot.hpp"
+#include "SpineWorld.hpp"
 
 #ifndef SPINE_MESH_VERTEX_COUNT_MAX
 #define SPINE_MESH_VERTEX_COUNT_MAX 1000
@@ -16,12 +21,15 @@ struct spSkeleton;
 struct spAtlas;
 struct spAnimationState;
 struct spAnimationStateData;
-struct spSkeletonBounds;
 struct spEvent;
 struct spTrackEntry;
+struct spSkin;
+struct spSlot;
+struct spAttachment;
 
 namespace spine
 {
+    // Component drawing an instance stored in a SpineWorld, the world must outlive its drawables
     class SpineDrawable: public ouzel::scene::Component
     {
     public:
@@ -45,8 +53,10 @@ namespace spine
         };
 
         static const uint32_t TYPE = 0x5350494e; // SPIN
+        static constexpr float DEFAULT_POSE_SHARING_INTERVAL = 1.0f / 60.0f;
 
-        SpineDrawable(const std::string& atlasFile, const std::string& skeletonFile);
+        SpineDrawable(SpineWorld& initWorld, const std::string& atlasFile, const std::string& skeletonFile,
+                      const LoadSettings& loadSettings = LoadSettings());
         virtual ~SpineDrawable();
 
         void update(float delta);
@@ -82,41 +92,127 @@ namespace spine
         float getAnimationProgress(int32_t trackIndex) const;
         std::string getAnimationName(int32_t trackIndex) const;
 
-        spSkeleton* getSkeleton() const { return skeleton; }
-        spAtlas* getAtlas() const { return atlas; }
-        spAnimationState* getAnimationState() const { return animationState; }
+        SpineWorld* getWorld() const { return world; }
+        SpineWorld::Handle getHandle() const { return handle; }
+
+        // false if the data failed to load, the other methods do nothing then
+        bool isValid() const { return world->isValid(handle); }
+
+        // null if the drawable is not valid
+        const std::shared_ptr<SpineData>& getData() const;
+        // brings the skeleton up to date and stops sharing poses until reset, because anything changed
+        // directly (slot colors, attachments, bones) is not part of the pose key
+        spSkeleton* getSkeleton();
+        // the last pose the drawable evaluated itself, see updateSkeleton
+        const spSkeleton* getSkeleton() const { return isValid() ? world->getSkeleton(handle) : nullptr; }
+        spAtlas* getAtlas() const { return isValid() ? getData()->getAtlas() : nullptr; }
+        spAnimationState* getAnimationState() const { return isValid() ? world->getAnimationState(handle) : nullptr; }
+
+        // paused drawables are skipped by the world update
+        void setPaused(bool newPaused);
+        bool isPaused() const;
+
+        // saves or restores the animation state, for rollback the snapshot can be reused every frame
+        void saveSnapshot(Snapshot& snapshot);
+        bool restoreSnapshot(const Snapshot& snapshot);
 
         void setEventCallback(const std::function<void(int32_t, const Event&)>& newEventCallback);
         void handleEvent(int type, spTrackEntry* entry, spEvent* event);
 
         void setSkin(const std::string& skinName);
+        // composes the skins in the given order (later skins override earlier ones), composed skins are cached in the data
+        bool setSkins(const std::vector<std::string>& skinNames);
+        std::string getSkin() const;
 
+        // materials and sort keys indexed by slot, materials are shared with other drawables
         const std::vector<std::shared_ptr<ouzel::graphics::Material>>& getMaterials() const { return materials; }
+        const std::vector<uint32_t>& getSortKeys() const { return sortKeys; }
+
+        const Stats& getStats() const;
+
+        // reuse poses of other instances playing the same single track animation, skipped while an event callback or
+        // a track entry listener is set, while an animation is queued and after the skeleton was changed directly,
+        // a drawable drawn from a shared pose doesn't apply its animation state, so its bones, slots and draw order
+        // keep the last pose it evaluated itself
+        void setPoseSharing(bool newPoseSharing);
+        bool isPoseSharing() const;
+
+        void setPoseSharingInterval(float newPoseSharingInterval);
+        float getPoseSharingInterval() const { return poseSharingInterval; }
+
+        // applies the animation state to the skeleton if the last draw used a shared pose, call it before
+        // reading the bones or slots through the const getSkeleton, saveSnapshot does it automatically
+        void updateSkeleton();
+
+        // geometry built by the last draw that didn't reuse a shared pose
+        const std::vector<uint16_t>& getIndices() const { return indices; }
+        const std::vector<ouzel::graphics::Vertex>& getVertices() const { return vertices; }
+
+        // the next draw rebuilds every slot, needed after attachments were changed in place because only
+        // bones, slot colors, deform vertices, attachments and the draw order are checked for changes
+        void invalidateGeometry() { geometryValid = false; }
 
     private:
-        bool handleUpdate(const ouzel::UpdateEvent& event);
+        uint32_t getProfilerId() const { return world->getProfilerId(handle); }
+
+        void applySkin(spSkin* skin);
         void updateBoundingBox();
+        void updateSlotBoundingBox(spSlot* slot);
+        void mergeSlotBoundingBoxes();
         void updateMaterials();
 
-        spSkeletonData* skeletonData = nullptr;
-        spSkeleton* skeleton = nullptr;
-        spAtlas* atlas = nullptr;
-        spAnimationState* animationState = nullptr;
-        spAnimationStateData* animationStateData = nullptr;
-        spSkeletonBounds* bounds = nullptr;
+        bool getPoseKey(PoseCache::Key& key) const;
+        void applyAnimation();
+        void buildGeometry();
+        void updateChangedBones();
+        bool isTopologyChanged() const;
+        bool isSlotChanged(const spSlot* slot, const ouzel::Color& color) const;
+        void updateChangedSlots();
+        void uploadGeometry(ouzel::graphics::Buffer& targetIndexBuffer,
+                            ouzel::graphics::Buffer& targetVertexBuffer);
+        void submit(const std::vector<DrawCommand>& commands,
+                    ouzel::graphics::Buffer& sourceIndexBuffer,
+                    ouzel::graphics::Buffer& sourceVertexBuffer,
+                    const std::vector<std::vector<float>>& vertexShaderConstants,
+                    float opacity,
+                    bool wireframe);
+
+        SpineWorld* world;
+        SpineWorld::Handle handle = SpineWorld::INVALID_HANDLE;
 
         std::vector<std::shared_ptr<ouzel::graphics::Material>> materials;
+        std::vector<uint32_t> sortKeys;
+        std::vector<ouzel::Box3> slotBoundingBoxes;
+        std::vector<spAttachment*> slotAttachments;
 
         std::vector<uint16_t> indices;
         std::vector<ouzel::graphics::Vertex> vertices;
+        std::vector<DrawCommand> drawCommands;
+
+        // state of the last built geometry, used to rebuild only the slots that changed
+        bool geometryValid = false;
+        uint32_t regionMeshVersion = 0;
+        bool indicesChanged = false;
+        bool verticesChanged = false;
+        std::vector<float> boneTransforms;
+        std::vector<bool> changedBones;
+        std::vector<const spSlot*> drawnSlots;
+        std::vector<const spAttachment*> drawnAttachments;
+        std::vector<uint32_t> slotVertexOffsets;
+        std::vector<uint32_t> slotVertexCounts;
 
         std::shared_ptr<ouzel::graphics::Buffer> indexBuffer;
         std::shared_ptr<ouzel::graphics::Buffer> vertexBuffer;
 
         std::shared_ptr<ouzel::graphics::Texture> whitePixelTexture;
 
-        ouzel::EventHandler updateHandler;
-
         std::function<void(int32_t, const Event&)> eventCallback;
+
+        float poseSharingInterval = DEFAULT_POSE_SHARING_INTERVAL;
+        std::shared_ptr<PoseCache::Pose> currentPose;
+        bool skeletonOutdated = false;
+        bool skeletonModified = false;
+
+        Sampler sampler;
     };
 }
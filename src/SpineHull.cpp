@@ -0,0 +1,205 @@
+// Copyright (C) 2017 Elviss Strazdins
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "SpineHull.hpp"
+#include "spine/spine.h"
+
+struct Point
+{
+    float x;
+    float y;
+};
+
+static float cross(const Point& origin, const Point& a, const Point& b)
+{
+    return (a.x - origin.x) * (b.y - origin.y) - (a.y - origin.y) * (b.x - origin.x);
+}
+
+// removes edges by extending their neighbouring edges until they meet, the polygon only grows so all
+// covered pixels stay inside, the edge adding the least area is removed first
+static void reduceVertices(std::vector<Point>& polygon, uint32_t maxVertices, float minX, float minY, float maxX, float maxY)
+{
+    while (polygon.size() > maxVertices && polygon.size() > 3)
+    {
+        size_t count = polygon.size();
+        size_t bestEdge = count;
+        Point bestPoint = {0.0f, 0.0f};
+        float bestArea = std::numeric_limits<float>::max();
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const Point& a = polygon[(i + count - 1) % count];
+            const Point& b = polygon[i];
+            const Point& c = polygon[(i + 1) % count];
+            const Point& d = polygon[(i + 2) % count];
+
+            Point u = {b.x - a.x, b.y - a.y};
+            Point v = {c.x - d.x, c.y - d.y};
+            Point w = {c.x - b.x, c.y - b.y};
+
+            float denominator = u.x * v.y - u.y * v.x;
+            if (std::fabs(denominator) < 1e-6f) continue;
+
+            float s = (w.x * v.y - w.y * v.x) / denominator;
+            float t = (w.x * u.y - w.y * u.x) / denominator;
+            if (s < 0.0f || t < 0.0f) continue;
+
+            Point point = {b.x + u.x * s, b.y + u.y * s};
+            if (point.x < minX || point.x > maxX || point.y < minY || point.y > maxY) continue;
+
+            float area = std::fabs(cross(point, b, c)) / 2.0f;
+
+            if (area < bestArea)
+            {
+                bestArea = area;
+                bestEdge = i;
+                bestPoint = point;
+            }
+        }
+
+        if (bestEdge == count) break;
+
+        polygon[bestEdge] = bestPoint;
+        polygon.erase(polygon.begin() + static_cast<std::ptrdiff_t>((bestEdge + 1) % count));
+    }
+}
+
+namespace spine
+{
+    void RegionMesh::computeWorldVertices(const float* corners, float* worldVertices) const
+    {
+        float originX = corners[2];
+        float originY = corners[3];
+        float firstX = corners[0] - originX;
+        float firstY = corners[1] - originY;
+        float secondX = corners[4] - originX;
+        float secondY = corners[5] - originY;
+
+        for (size_t i = 0; i < weights.size(); i += 2)
+        {
+            worldVertices[i] = originX + firstX * weights[i] + secondX * weights[i + 1];
+            worldVertices[i + 1] = originY + firstY * weights[i] + secondY * weights[i + 1];
+        }
+    }
+
+    std::vector<float> computeHull(const uint8_t* pixels, uint32_t pageWidth, int x, int y, int width, int height, const HullSettings& settings)
+    {
+        std::vector<Point> points;
+
+        // the outermost covered pixels of every row are enough to find the hull
+        for (int row = y; row < y + height; ++row)
+        {
+            const uint8_t* line = pixels + static_cast<size_t>(row) * pageWidth * 4;
+            int left = -1;
+            int right = -1;
+
+            for (int column = x; column < x + width; ++column)
+            {
+                if (line[static_cast<size_t>(column) * 4 + 3] > settings.alphaThreshold)
+                {
+                    if (left == -1) left = column;
+                    right = column;
+                }
+            }
+
+            if (left == -1) continue;
+
+            float top = static_cast<float>(row);
+            float bottom = static_cast<float>(row + 1);
+
+            points.push_back({static_cast<float>(left), top});
+            points.push_back({static_cast<float>(left), bottom});
+            points.push_back({static_cast<float>(right + 1), top});
+            points.push_back({static_cast<float>(right + 1), bottom});
+        }
+
+        std::vector<float> result;
+        if (points.empty()) return result;
+
+        std::sort(points.begin(), points.end(), [](const Point& a, const Point& b) {
+            return a.x < b.x || (a.x == b.x && a.y < b.y);
+        });
+
+        // monotone chain
+        std::vector<Point> polygon(points.size() * 2);
+        size_t count = 0;
+
+        for (size_t i = 0; i < points.size(); ++i)
+        {
+            while (count >= 2 && cross(polygon[count - 2], polygon[count - 1], points[i]) <= 0.0f) --count;
+            polygon[count++] = points[i];
+        }
+
+        for (size_t i = points.size() - 1, lower = count + 1; i > 0; --i)
+        {
+            while (count >= lower && cross(polygon[count - 2], polygon[count - 1], points[i - 1]) <= 0.0f) --count;
+            polygon[count++] = points[i - 1];
+        }
+
+        polygon.resize(count - 1);
+
+        reduceVertices(polygon, settings.maxVertices,
+                       static_cast<float>(x), static_cast<float>(y),
+                       static_cast<float>(x + width), static_cast<float>(y + height));
+
+        for (const Point& point : polygon)
+        {
+            result.push_back(point.x);
+            result.push_back(point.y);
+        }
+
+        return result;
+    }
+
+    float getPolygonArea(const std::vector<float>& polygon)
+    {
+        float area = 0.0f;
+
+        for (size_t i = 0; i < polygon.size(); i += 2)
+        {
+            size_t next = (i + 2) % polygon.size();
+            area += polygon[i] * polygon[next + 1] - polygon[next] * polygon[i + 1];
+        }
+
+        return std::fabs(area) / 2.0f;
+    }
+
+    RegionMesh createRegionMesh(const spRegionAttachment* regionAttachment, const std::vector<float>& polygon, float pageWidth, float pageHeight)
+    {
+        RegionMesh result;
+
+        // the polygon is mapped to the quad through its texture coordinates, which also covers rotated regions
+        const float* uvs = regionAttachment->uvs;
+        float firstU = uvs[0] - uvs[2];
+        float firstV = uvs[1] - uvs[3];
+        float secondU = uvs[4] - uvs[2];
+        float secondV = uvs[5] - uvs[3];
+        float determinant = firstU * secondV - firstV * secondU;
+
+        if (determinant == 0.0f) return result;
+
+        for (size_t i = 0; i + 1 < polygon.size(); i += 2)
+        {
+            float u = polygon[i] / pageWidth;
+            float v = polygon[i + 1] / pageHeight;
+            float relativeU = u - uvs[2];
+            float relativeV = v - uvs[3];
+
+            result.uvs.push_back(u);
+            result.uvs.push_back(v);
+            result.weights.push_back((relativeU * secondV - relativeV * secondU) / determinant);
+            result.weights.push_back((firstU * relativeV - firstV * relativeU) / determinant);
+        }
+
+        for (uint32_t i = 1; i + 1 < result.getVertexCount(); ++i)
+        {
+            result.triangles.push_back(0);
+            result.triangles.push_back(static_cast<uint16_t>(i));
+            result.triangles.push_back(static_cast<uint16_t>(i + 1));
+        }
+
+        return result;
+    }
+}
@@ -0,0 +1,53 @@
+// Copyright (C) 2017 Elviss Strazdins
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct spRegionAttachment;
+
+namespace spine
+{
+    struct HullSettings
+    {
+        // pixels with alpha above the threshold are covered
+        uint8_t alphaThreshold = 0;
+        uint32_t maxVertices = 8;
+        // regions whose hull covers more of the rectangle than this are drawn as quads
+        float maxCoverage = 0.85f;
+    };
+
+    struct HullReport
+    {
+        std::string page;
+        uint32_t regionCount = 0;
+        uint32_t hullCount = 0;
+        // drawn area of all regions in pixels, as rectangles and with the hulls
+        uint64_t rectangleArea = 0;
+        uint64_t hullArea = 0;
+        uint32_t hullVertexCount = 0;
+    };
+
+    // Region attachment drawn as a convex polygon, vertices are stored as weights of two edges of
+    // the attachment's quad so that any bone transform maps them like the quad corners
+    struct RegionMesh
+    {
+        std::vector<float> weights;
+        std::vector<float> uvs;
+        std::vector<uint16_t> triangles;
+
+        uint32_t getVertexCount() const { return static_cast<uint32_t>(weights.size() / 2); }
+
+        // corners are the output of spRegionAttachment_computeWorldVertices
+        void computeWorldVertices(const float* corners, float* worldVertices) const;
+    };
+
+    // convex polygon in page pixels around the covered pixels of the rectangle with at most
+    // settings.maxVertices vertices where possible, empty if no pixel is covered
+    std::vector<float> computeHull(const uint8_t* pixels, uint32_t pageWidth, int x, int y, int width, int height, const HullSettings& settings);
+    float getPolygonArea(const std::vector<float>& polygon);
+
+    RegionMesh createRegionMesh(const spRegionAttachment* regionAttachment, const std::vector<float>& polygon, float pageWidth, float pageHeight);
+}
@@ -0,0 +1,83 @@
+// Copyright (C) 2017 Elviss Strazdins
+
+#include "SpinePoseCache.hpp"
+
+namespace spine
+{
+    bool PoseCache::Key::operator<(const Key& other) const
+    {
+        if (animation != other.animation) return animation < other.animation;
+        if (skin != other.skin) return skin < other.skin;
+        if (frame != other.frame) return frame < other.frame;
+        if (flipX != other.flipX) return flipX < other.flipX;
+        if (flipY != other.flipY) return flipY < other.flipY;
+        if (x != other.x) return x < other.x;
+        return y < other.y;
+    }
+
+    std::shared_ptr<PoseCache::Pose> PoseCache::find(const Key& key)
+    {
+        auto i = poses.find(key);
+
+        if (i == poses.end())
+        {
+            ++misses;
+            return nullptr;
+        }
+
+        ++hits;
+        i->second->lastUse = ++useCounter;
+        return i->second;
+    }
+
+    std::shared_ptr<PoseCache::Pose> PoseCache::create(const Key& key)
+    {
+        if (poses.size() >= maxPoses)
+        {
+            // evict the least recently used pose
+            auto oldest = poses.begin();
+            for (auto i = poses.begin(); i != poses.end(); ++i)
+                if (i->second->lastUse < oldest->second->lastUse) oldest = i;
+
+            if (oldest != poses.end()) poses.erase(oldest);
+        }
+
+        std::shared_ptr<Pose> pose = std::make_shared<Pose>();
+        pose->lastUse = ++useCounter;
+
+        pose->indexBuffer = std::make_shared<ouzel::graphics::Buffer>(*ouzel::engine->getRenderer());
+        pose->indexBuffer->init(ouzel::graphics::Buffer::Usage::INDEX, ouzel::graphics::Buffer::DYNAMIC);
+
+        pose->vertexBuffer = std::make_shared<ouzel::graphics::Buffer>(*ouzel::engine->getRenderer());
+        pose->vertexBuffer->init(ouzel::graphics::Buffer::Usage::VERTEX, ouzel::graphics::Buffer::DYNAMIC);
+
+        poses[key] = pose;
+
+        return pose;
+    }
+
+    void PoseCache::clear()
+    {
+        poses.clear();
+    }
+
+    float PoseCache::getHitRate() const
+    {
+        uint64_t total = hits + misses;
+        return total ? static_cast<float>(hits) / static_cast<float>(total) : 0.0f;
+    }
+
+    uint64_t PoseCache::getBufferMemory() const
+    {
+        uint64_t size = 0;
+
+        for (const auto& i : poses)
+        {
+            size += i.second->indexCount * sizeof(uint16_t) +
+                i.second->vertexCount * sizeof(ouzel::graphics::Vertex) +
+                i.second->drawCommands.capacity() * sizeof(DrawCommand);
+        }
+
+        return size;
+    }
+}
@@ -0,0 +1,75 @@
+// Copyright (C) 2017 Elviss Strazdins
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+#include "ouzel.hpp"
+
+struct spAnimation;
+struct spSkin;
+
+namespace spine
+{
+    struct DrawCommand
+    {
+        std::shared_ptr<ouzel::graphics::Material> material;
+        uint32_t sortKey;
+        uint32_t indexCount;
+        uint32_t offset;
+    };
+
+    // Skeleton space geometry of poses evaluated by drawables playing the same animation
+    class PoseCache
+    {
+    public:
+        struct Key
+        {
+            const spAnimation* animation;
+            const spSkin* skin;
+            int32_t frame;
+            bool flipX;
+            bool flipY;
+            float x;
+            float y;
+
+            bool operator<(const Key& other) const;
+        };
+
+        struct Pose
+        {
+            std::vector<DrawCommand> drawCommands;
+            std::shared_ptr<ouzel::graphics::Buffer> indexBuffer;
+            std::shared_ptr<ouzel::graphics::Buffer> vertexBuffer;
+            ouzel::Box3 boundingBox;
+            uint32_t vertexCount = 0;
+            uint32_t indexCount = 0;
+            uint64_t lastUse = 0;
+        };
+
+        static const size_t DEFAULT_MAX_POSES = 256;
+
+        std::shared_ptr<Pose> find(const Key& key);
+        std::shared_ptr<Pose> create(const Key& key);
+        void clear();
+
+        void setMaxPoses(size_t newMaxPoses) { maxPoses = newMaxPoses; }
+        size_t getMaxPoses() const { return maxPoses; }
+        size_t getPoseCount() const { return poses.size(); }
+
+        uint64_t getHits() const { return hits; }
+        uint64_t getMisses() const { return misses; }
+        float getHitRate() const;
+
+        uint64_t getBufferMemory() const;
+
+    private:
+        std::map<Key, std::shared_ptr<Pose>> poses;
+        size_t maxPoses = DEFAULT_MAX_POSES;
+        uint64_t useCounter = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+}
@@ -0,0 +1,380 @@
+// Copyright (C) 2017 Elviss Strazdins
+
+#include <algorithm>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include "SpineProfiler.hpp"
+#include "SpineDrawable.hpp"
+#include "SpineCompression.hpp"
+#include "SpineCurves.hpp"
+#include "SpineSampler.hpp"
+#include "spine/spine.h"
+#include "spine/extension.h"
+
+static uint64_t getCurveTimelineMemory(int framesCount, int entries)
+{
+    int frames = framesCount / entries;
+    uint64_t size = static_cast<uint64_t>(framesCount) * sizeof(float);
+    if (frames > 1) size += static_cast<uint64_t>((frames - 1) * spine::CURVE_SIZE) * sizeof(float);
+    return size;
+}
+
+static uint64_t getTimelineMemory(const spTimeline* timeline)
+{
+    if (const spine::CompressedTimeline* compressedTimeline = spine::Sampler::getCompressedTimeline(timeline))
+        return sizeof(spBaseTimeline) + compressedTimeline->getMemory();
+
+    switch (timeline->type)
+    {
+        case SP_TIMELINE_ROTATE:
+        {
+            const spRotateTimeline* rotateTimeline = reinterpret_cast<const spRotateTimeline*>(timeline);
+            return sizeof(spRotateTimeline) + getCurveTimelineMemory(rotateTimeline->framesCount, 2);
+        }
+        case SP_TIMELINE_TRANSLATE:
+        case SP_TIMELINE_SCALE:
+        case SP_TIMELINE_SHEAR:
+        {
+            const spBaseTimeline* baseTimeline = reinterpret_cast<const spBaseTimeline*>(timeline);
+            return sizeof(spBaseTimeline) + getCurveTimelineMemory(baseTimeline->framesCount, 3);
+        }
+        case SP_TIMELINE_COLOR:
+        {
+            const spColorTimeline* colorTimeline = reinterpret_cast<const spColorTimeline*>(timeline);
+            return sizeof(spColorTimeline) + getCurveTimelineMemory(colorTimeline->framesCount, 5);
+        }
+        case SP_TIMELINE_TWOCOLOR:
+        {
+            const spTwoColorTimeline* twoColorTimeline = reinterpret_cast<const spTwoColorTimeline*>(timeline);
+            return sizeof(spTwoColorTimeline) + getCurveTimelineMemory(twoColorTimeline->framesCount, 8);
+        }
+        case SP_TIMELINE_IKCONSTRAINT:
+        {
+            const spIkConstraintTimeline* ikTimeline = reinterpret_cast<const spIkConstraintTimeline*>(timeline);
+            return sizeof(spIkConstraintTimeline) + getCurveTimelineMemory(ikTimeline->framesCount, 3);
+        }
+        case SP_TIMELINE_TRANSFORMCONSTRAINT:
+        {
+            const spTransformConstraintTimeline* transformTimeline = reinterpret_cast<const spTransformConstraintTimeline*>(timeline);
+            return sizeof(spTransformConstraintTimeline) + getCurveTimelineMemory(transformTimeline->framesCount, 5);
+        }
+        case SP_TIMELINE_PATHCONSTRAINTPOSITION:
+        case SP_TIMELINE_PATHCONSTRAINTSPACING:
+        {
+            const spPathConstraintPositionTimeline* pathTimeline = reinterpret_cast<const spPathConstraintPositionTimeline*>(timeline);
+            return sizeof(spPathConstraintPositionTimeline) + getCurveTimelineMemory(pathTimeline->framesCount, 2);
+        }
+        case SP_TIMELINE_PATHCONSTRAINTMIX:
+        {
+            const spPathConstraintMixTimeline* pathTimeline = reinterpret_cast<const spPathConstraintMixTimeline*>(timeline);
+            return sizeof(spPathConstraintMixTimeline) + getCurveTimelineMemory(pathTimeline->framesCount, 3);
+        }
+        case SP_TIMELINE_DEFORM:
+        {
+            const spDeformTimeline* deformTimeline = reinterpret_cast<const spDeformTimeline*>(timeline);
+            return sizeof(spDeformTimeline) + getCurveTimelineMemory(deformTimeline->framesCount, 1) +
+                static_cast<uint64_t>(deformTimeline->framesCount) * (sizeof(float*) + static_cast<uint64_t>(deformTimeline->frameVerticesCount) * sizeof(float));
+        }
+        case SP_TIMELINE_ATTACHMENT:
+        {
+            const spAttachmentTimeline* attachmentTimeline = reinterpret_cast<const spAttachmentTimeline*>(timeline);
+            uint64_t size = sizeof(spAttachmentTimeline) + static_cast<uint64_t>(attachmentTimeline->framesCount) * (sizeof(float) + sizeof(char*));
+            for (int i = 0; i < attachmentTimeline->framesCount; ++i)
+                if (attachmentTimeline->attachmentNames[i]) size += strlen(attachmentTimeline->attachmentNames[i]) + 1;
+            return size;
+        }
+        case SP_TIMELINE_EVENT:
+        {
+            const spEventTimeline* eventTimeline = reinterpret_cast<const spEventTimeline*>(timeline);
+            return sizeof(spEventTimeline) + static_cast<uint64_t>(eventTimeline->framesCount) * (sizeof(float) + sizeof(spEvent*) + sizeof(spEvent));
+        }
+        case SP_TIMELINE_DRAWORDER:
+        {
+            const spDrawOrderTimeline* drawOrderTimeline = reinterpret_cast<const spDrawOrderTimeline*>(timeline);
+            uint64_t size = sizeof(spDrawOrderTimeline) + static_cast<uint64_t>(drawOrderTimeline->framesCount) * (sizeof(float) + sizeof(int*));
+            for (int i = 0; i < drawOrderTimeline->framesCount; ++i)
+                if (drawOrderTimeline->drawOrders[i]) size += static_cast<uint64_t>(drawOrderTimeline->slotsCount) * sizeof(int);
+            return size;
+        }
+    }
+
+    return sizeof(spTimeline);
+}
+
+static uint64_t getAttachmentMemory(const spAttachment* attachment)
+{
+    switch (attachment->type)
+    {
+        case SP_ATTACHMENT_REGION:
+            return sizeof(spRegionAttachment);
+        case SP_ATTACHMENT_MESH:
+        case SP_ATTACHMENT_LINKED_MESH:
+        {
+            const spMeshAttachment* meshAttachment = reinterpret_cast<const spMeshAttachment*>(attachment);
+            uint64_t size = sizeof(spMeshAttachment) + static_cast<uint64_t>(meshAttachment->super.worldVerticesLength) * sizeof(float);
+
+            // linked meshes share everything but the uvs with their parent
+            if (!meshAttachment->parentMesh)
+            {
+                size += static_cast<uint64_t>(meshAttachment->super.verticesCount) * sizeof(float) +
+                    static_cast<uint64_t>(meshAttachment->super.bonesCount) * sizeof(int) +
+                    static_cast<uint64_t>(meshAttachment->super.worldVerticesLength) * sizeof(float) +
+                    static_cast<uint64_t>(meshAttachment->trianglesCount) * sizeof(unsigned short) +
+                    static_cast<uint64_t>(meshAttachment->edgesCount) * sizeof(int);
+            }
+
+            return size;
+        }
+        case SP_ATTACHMENT_BOUNDING_BOX:
+        case SP_ATTACHMENT_PATH:
+        case SP_ATTACHMENT_CLIPPING:
+        {
+            const spVertexAttachment* vertexAttachment = reinterpret_cast<const spVertexAttachment*>(attachment);
+            return sizeof(spVertexAttachment) +
+                static_cast<uint64_t>(vertexAttachment->verticesCount) * sizeof(float) +
+                static_cast<uint64_t>(vertexAttachment->bonesCount) * sizeof(int);
+        }
+        default:
+            return sizeof(spAttachment);
+    }
+}
+
+namespace spine
+{
+    const char* Stats::getSpanName(Span span)
+    {
+        switch (span)
+        {
+            case UPDATE: return "update";
+            case APPLY: return "apply";
+            case WORLD_TRANSFORM: return "worldTransform";
+            case VERTEX_BUILD: return "vertexBuild";
+            case UPLOAD: return "upload";
+            case SUBMIT: return "submit";
+            default: return "unknown";
+        }
+    }
+
+    void Stats::resetFrame()
+    {
+        std::fill(std::begin(durations), std::end(durations), 0);
+        vertexCount = 0;
+        indexCount = 0;
+        drawCallCount = 0;
+        uploadedBytes = 0;
+        poseHits = 0;
+        poseMisses = 0;
+        keyframeHits = 0;
+        keyframeSearches = 0;
+        skippedSlotCount = 0;
+        skippedVertexCount = 0;
+    }
+
+    Stats& Stats::operator+=(const Stats& other)
+    {
+        for (int i = 0; i < SPAN_COUNT; ++i)
+            durations[i] += other.durations[i];
+
+        vertexCount += other.vertexCount;
+        indexCount += other.indexCount;
+        drawCallCount += other.drawCallCount;
+        uploadedBytes += other.uploadedBytes;
+        poseHits += other.poseHits;
+        poseMisses += other.poseMisses;
+        keyframeHits += other.keyframeHits;
+        keyframeSearches += other.keyframeSearches;
+        skippedSlotCount += other.skippedSlotCount;
+        skippedVertexCount += other.skippedVertexCount;
+        skeletonDataMemory += other.skeletonDataMemory;
+        atlasPageMemory += other.atlasPageMemory;
+        bufferMemory += other.bufferMemory;
+
+        return *this;
+    }
+
+    uint64_t getSkeletonDataMemory(const spSkeletonData* skeletonData)
+    {
+        if (!skeletonData) return 0;
+
+        uint64_t size = sizeof(spSkeletonData);
+
+        size += static_cast<uint64_t>(skeletonData->bonesCount) * (sizeof(spBoneData*) + sizeof(spBoneData));
+        size += static_cast<uint64_t>(skeletonData->slotsCount) * (sizeof(spSlotData*) + sizeof(spSlotData));
+
+        for (int i = 0; i < skeletonData->skinsCount; ++i)
+        {
+            size += sizeof(_spSkin);
+
+            for (const _Entry* entry = SUB_CAST(_spSkin, skeletonData->skins[i])->entries; entry; entry = entry->next)
+            {
+                size += sizeof(_Entry) + strlen(entry->name) + 1;
+                if (entry->attachment) size += getAttachmentMemory(entry->attachment);
+            }
+        }
+
+        for (int i = 0; i < skeletonData->animationsCount; ++i)
+            size += getAnimationMemory(skeletonData->animations[i]);
+
+        return size;
+    }
+
+    uint64_t getAnimationMemory(const spAnimation* animation)
+    {
+        uint64_t size = sizeof(spAnimation) + static_cast<uint64_t>(animation->timelinesCount) * sizeof(spTimeline*);
+
+        for (int t = 0; t < animation->timelinesCount; ++t)
+            size += getTimelineMemory(animation->timelines[t]);
+
+        return size;
+    }
+
+    Profiler::Scope::Scope(Stats& initStats, Stats::Span initSpan, uint32_t initDrawableId):
+        stats(initStats), span(initSpan), drawableId(initDrawableId), start(std::chrono::steady_clock::now())
+    {
+    }
+
+    Profiler::Scope::~Scope()
+    {
+        end();
+    }
+
+    void Profiler::Scope::end()
+    {
+        if (!running) return;
+        running = false;
+
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        stats.durations[span] += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+
+        Profiler& profiler = Profiler::getInstance();
+        if (profiler.isTracing()) profiler.addTraceEvent(span, drawableId, start, end);
+    }
+
+    Profiler& Profiler::getInstance()
+    {
+        static Profiler instance;
+        return instance;
+    }
+
+    Profiler::Profiler():
+        startTime(std::chrono::steady_clock::now())
+    {
+    }
+
+    uint32_t Profiler::addDrawable(SpineDrawable* drawable)
+    {
+        drawables.push_back(drawable);
+        return ++lastDrawableId;
+    }
+
+    void Profiler::removeDrawable(SpineDrawable* drawable)
+    {
+        auto i = std::find(drawables.begin(), drawables.end(), drawable);
+        if (i != drawables.end()) drawables.erase(i);
+    }
+
+    Stats Profiler::getFrameStats() const
+    {
+        Stats result;
+        std::set<const SpineData*> countedData;
+
+        for (const SpineDrawable* drawable : drawables)
+        {
+            Stats drawableStats = drawable->getStats();
+
+            if (countedData.insert(drawable->getData().get()).second)
+            {
+                if (drawable->getData()) drawableStats.bufferMemory += drawable->getData()->getPoseCache().getBufferMemory();
+            }
+            else
+            {
+                drawableStats.skeletonDataMemory = 0;
+                drawableStats.atlasPageMemory = 0;
+            }
+
+            result += drawableStats;
+        }
+
+        return result;
+    }
+
+    void Profiler::addTraceEvent(Stats::Span span, uint32_t drawableId,
+                                 std::chrono::steady_clock::time_point eventStart,
+                                 std::chrono::steady_clock::time_point eventEnd)
+    {
+        TraceEvent event;
+        event.span = span;
+        event.drawableId = drawableId;
+        event.start = std::chrono::duration_cast<std::chrono::nanoseconds>(eventStart - startTime).count();
+        event.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(eventEnd - eventStart).count();
+
+        if (traceEvents.size() < maxTraceEvents)
+            traceEvents.push_back(event);
+        else if (maxTraceEvents)
+        {
+            traceEvents[firstTraceEvent] = event;
+            firstTraceEvent = (firstTraceEvent + 1) % maxTraceEvents;
+        }
+    }
+
+    void Profiler::clearTrace()
+    {
+        traceEvents.clear();
+        firstTraceEvent = 0;
+    }
+
+    void Profiler::setMaxTraceEvents(size_t newMaxTraceEvents)
+    {
+        // keep the newest events in order
+        std::rotate(traceEvents.begin(), traceEvents.begin() + static_cast<std::ptrdiff_t>(firstTraceEvent), traceEvents.end());
+        firstTraceEvent = 0;
+
+        if (traceEvents.size() > newMaxTraceEvents)
+            traceEvents.erase(traceEvents.begin(), traceEvents.end() - static_cast<std::ptrdiff_t>(newMaxTraceEvents));
+
+        maxTraceEvents = newMaxTraceEvents;
+    }
+
+    std::string Profiler::getTraceJson() const
+    {
+        std::ostringstream json;
+        json << "{\"traceEvents\":[";
+
+        for (size_t i = 0; i < traceEvents.size(); ++i)
+        {
+            const TraceEvent& event = traceEvents[(firstTraceEvent + i) % traceEvents.size()];
+
+            if (i > 0) json << ",";
+            json << "\n{\"name\":\"" << Stats::getSpanName(event.span) << "\"," <<
+                "\"cat\":\"spine\",\"ph\":\"X\",\"pid\":1,\"tid\":1," <<
+                "\"ts\":" << event.start / 1000 << "." << event.start % 1000 / 100 << "," <<
+                "\"dur\":" << event.duration / 1000 << "." << event.duration % 1000 / 100 << "," <<
+                "\"args\":{\"drawable\":" << event.drawableId << "}}";
+        }
+
+        json << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+        return json.str();
+    }
+
+    bool Profiler::saveTrace(const std::string& filename) const
+    {
+        // the working directory is not writable on every platform
+        std::string path = ouzel::engine->getFileSystem().getStorageDirectory() + "/" + filename;
+        std::string json = getTraceJson();
+
+        try
+        {
+            // writeFile throws on failure
+            ouzel::engine->getFileSystem().writeFile(path, std::vector<uint8_t>(json.begin(), json.end()));
+        }
+        catch (const std::exception& e)
+        {
+            ouzel::Log(ouzel::Log::Level::ERR) << "Failed to write " << path << ": " << e.what();
+            return false;
+        }
+
+        return true;
+    }
+}
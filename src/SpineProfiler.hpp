@@ -0,0 +1,129 @@
+// Copyright (C) 2017 Elviss Strazdins
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct spSkeletonData;
+struct spAnimation;
+
+namespace spine
+{
+    class SpineDrawable;
+
+    struct Stats
+    {
+        enum Span
+        {
+            UPDATE,
+            APPLY,
+            WORLD_TRANSFORM,
+            VERTEX_BUILD,
+            UPLOAD,
+            SUBMIT,
+            SPAN_COUNT
+        };
+
+        static const char* getSpanName(Span span);
+
+        // time spent in each span during the last frame, in nanoseconds
+        uint64_t durations[SPAN_COUNT] = {};
+
+        uint32_t vertexCount = 0;
+        uint32_t indexCount = 0;
+        uint32_t drawCallCount = 0;
+        uint64_t uploadedBytes = 0;
+        uint32_t poseHits = 0;
+        uint32_t poseMisses = 0;
+        uint32_t keyframeHits = 0;
+        uint32_t keyframeSearches = 0;
+        // geometry left untouched because its slots didn't change
+        uint32_t skippedSlotCount = 0;
+        uint32_t skippedVertexCount = 0;
+
+        // resident memory, in bytes
+        uint64_t skeletonDataMemory = 0;
+        uint64_t atlasPageMemory = 0;
+        uint64_t bufferMemory = 0;
+
+        void resetFrame();
+
+        Stats& operator+=(const Stats& other);
+    };
+
+    uint64_t getSkeletonDataMemory(const spSkeletonData* skeletonData);
+    uint64_t getAnimationMemory(const spAnimation* animation);
+
+    class Profiler
+    {
+    public:
+        class Scope
+        {
+        public:
+            Scope(Stats& initStats, Stats::Span initSpan, uint32_t initDrawableId);
+            ~Scope();
+
+            void end();
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            Stats& stats;
+            Stats::Span span;
+            uint32_t drawableId;
+            bool running = true;
+            std::chrono::steady_clock::time_point start;
+        };
+
+        static Profiler& getInstance();
+
+        uint32_t addDrawable(SpineDrawable* drawable);
+        void removeDrawable(SpineDrawable* drawable);
+
+        // sum of the last frame stats of all live drawables, counting shared data only once
+        Stats getFrameStats() const;
+
+        void setTracing(bool newTracing) { tracing = newTracing; }
+        bool isTracing() const { return tracing; }
+
+        void addTraceEvent(Stats::Span span, uint32_t drawableId,
+                           std::chrono::steady_clock::time_point eventStart,
+                           std::chrono::steady_clock::time_point eventEnd);
+        void clearTrace();
+
+        // once the limit is reached the oldest events are dropped
+        void setMaxTraceEvents(size_t newMaxTraceEvents);
+        size_t getMaxTraceEvents() const { return maxTraceEvents; }
+
+        // Chrome trace event format, loadable in chrome://tracing
+        std::string getTraceJson() const;
+        // the file is written to the storage directory of the application, returns false and logs
+        // the error if it can't be written
+        bool saveTrace(const std::string& filename) const;
+
+    private:
+        Profiler();
+
+        struct TraceEvent
+        {
+            Stats::Span span;
+            uint32_t drawableId;
+            int64_t start; // in nanoseconds since profiler creation
+            int64_t duration;
+        };
+
+        std::chrono::steady_clock::time_point startTime;
+        std::vector<SpineDrawable*> drawables;
+        uint32_t lastDrawableId = 0;
+
+        bool tracing = false;
+        // ring buffer, firstTraceEvent is the oldest event once it is full
+        std::vector<TraceEvent> traceEvents;
+        size_t firstTraceEvent = 0;
+        size_t maxTraceEvents = 100000;
+    };
+}
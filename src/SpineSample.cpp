@@ -6,8 +6,7 @@
 using namespace std;
 using namespace ouzel;
 
-SpineSample::SpineSample():
-    bundle(engine->getCache())
+SpineSample::SpineSample()
 {
 #if OUZEL_PLATFORM_LINUX
     engine->getFileSystem().addResourcePath("Resources");
@@ -31,8 +30,11 @@ SpineSample::SpineSample():
     layer.addChild(&cameraActor);
     scene.addLayer(&layer);
 
-    bundle.loadAsset(assets::Loader::Type::IMAGE, "spineboy.png");
-    spineBoy.reset(new spine::SpineDrawable("spineboy.atlas", "spineboy.skel"));
+    spineWorld.reset(new spine::SpineWorld());
+    spine::LoadSettings loadSettings;
+    loadSettings.lazyAnimations = true;
+    loadSettings.preloadAnimations = {"jump", "run"};
+    spineBoy.reset(new spine::SpineDrawable(*spineWorld, "spineboy.atlas", "spineboy.skel", loadSettings));
 
     actor.addComponent(spineBoy.get());
     actor.setPosition({0, -100});
@@ -90,6 +92,121 @@ bool SpineSample::handleKeyboard(const KeyboardEvent& event)
             case input::Keyboard::Key::ENTER:
                 engine->getWindow()->setSize(Size2(640.0f, 480.0f));
                 break;
+            case input::Keyboard::Key::S:
+            {
+                spine::Stats stats = spine::Profiler::getInstance().getFrameStats();
+
+                Log(Log::Level::INFO) << "Spine frame stats: " <<
+                    "update " << stats.durations[spine::Stats::UPDATE] / 1000 << " us, " <<
+                    "apply " << stats.durations[spine::Stats::APPLY] / 1000 << " us, " <<
+                    "world transform " << stats.durations[spine::Stats::WORLD_TRANSFORM] / 1000 << " us, " <<
+                    "vertex build " << stats.durations[spine::Stats::VERTEX_BUILD] / 1000 << " us, " <<
+                    "upload " << stats.durations[spine::Stats::UPLOAD] / 1000 << " us, " <<
+                    "submit " << stats.durations[spine::Stats::SUBMIT] / 1000 << " us, " <<
+                    stats.vertexCount << " vertices, " << stats.indexCount << " indices, " <<
+                    stats.drawCallCount << " draw calls, " << stats.uploadedBytes << " bytes uploaded, " <<
+                    stats.poseHits << " pose hits, " << stats.poseMisses << " pose misses, " <<
+                    stats.keyframeHits << " keyframe hits, " << stats.keyframeSearches << " keyframe searches, " <<
+                    stats.skippedSlotCount << " slots skipped, " <<
+                    (stats.vertexCount ? 100.0f * stats.skippedVertexCount / stats.vertexCount : 0.0f) << "% of vertices skipped, " <<
+                    "skeleton data " << stats.skeletonDataMemory << " bytes, " <<
+                    "atlas pages " << stats.atlasPageMemory << " bytes, " <<
+                    "buffers " << stats.bufferMemory << " bytes";
+                break;
+            }
+            case input::Keyboard::Key::T:
+            {
+                spine::Profiler& profiler = spine::Profiler::getInstance();
+
+                if (profiler.isTracing())
+                {
+                    profiler.setTracing(false);
+                    if (profiler.saveTrace("spine_trace.json"))
+                        Log(Log::Level::INFO) << "Spine trace saved to " << engine->getFileSystem().getStorageDirectory() << "/spine_trace.json";
+                    else
+                        Log(Log::Level::ERR) << "Failed to save spine trace";
+                    profiler.clearTrace();
+                }
+                else
+                    profiler.setTracing(true);
+                break;
+            }
+            case input::Keyboard::Key::B:
+            {
+                std::shared_ptr<spine::SpineData> data = spineBoy->getData();
+
+                for (int32_t i = 0; i < data->getAnimationCount(); ++i)
+                    data->getAnimation(i);
+
+                std::vector<spine::SamplingBenchmark> results = spine::benchmarkSampling(data->getSkeletonData(), data->getTimelineCount(), 10000);
+
+                for (const spine::SamplingBenchmark& result : results)
+                {
+                    Log(Log::Level::INFO) << "Sampling " << result.animation << " (" << result.timelineCount << " timelines): " <<
+                        "search " << result.searchDuration << " ns, " <<
+                        "cursor " << result.cursorDuration << " ns per skeleton, " <<
+                        "cursor hit rate " << result.hitRate * 100.0f << "%";
+                }
+                break;
+            }
+            case input::Keyboard::Key::C:
+            {
+                std::shared_ptr<spine::SpineData> data = spineBoy->getData();
+                std::vector<spine::CompressionReport> reports = data->compressAnimations();
+
+                Log(Log::Level::INFO) << "Compressed " << reports.size() << " of " << data->getAnimationCount() <<
+                    " animations, the others are compressed when they are loaded";
+
+                for (const spine::CompressionReport& report : reports)
+                {
+                    Log(Log::Level::INFO) << "Compressed " << report.animation << ": " <<
+                        report.originalSize << " -> " << report.compressedSize << " bytes, " <<
+                        report.originalKeyframes << " -> " << report.compressedKeyframes << " keyframes, " <<
+                        "max position error " << report.maxPositionError << ", " <<
+                        "max rotation error " << report.maxRotationError << " degrees";
+                }
+                break;
+            }
+            case input::Keyboard::Key::N:
+            {
+                spine::SnapshotBenchmark result = spine::benchmarkSnapshots(*spineBoy->getData(), 10000);
+
+                Log(Log::Level::INFO) << "Snapshot of " << result.entryCount << " track entries: " <<
+                    result.size << " bytes, " <<
+                    "capture " << result.captureDuration << " ns, " <<
+                    "restore " << result.restoreDuration << " ns, " <<
+                    "restore with rebuilt tracks " << result.rebuildDuration << " ns per skeleton";
+                break;
+            }
+            case input::Keyboard::Key::H:
+            {
+                std::vector<spine::HullReport> reports = spineBoy->getData()->buildRegionHulls();
+
+                for (const spine::HullReport& report : reports)
+                {
+                    Log(Log::Level::INFO) << "Hulls for " << report.page << ": " <<
+                        report.hullCount << " of " << report.regionCount << " regions, " <<
+                        report.hullVertexCount << " hull vertices, " <<
+                        report.rectangleArea << " -> " << report.hullArea << " pixels, " <<
+                        (report.rectangleArea ? 100.0f * (report.rectangleArea - report.hullArea) / report.rectangleArea : 0.0f) << "% saved";
+                }
+                break;
+            }
+            case input::Keyboard::Key::P:
+            {
+                std::vector<spine::AtlasPageReport> reports = spineBoy->getData()->getAtlasPageReports();
+
+                for (const spine::AtlasPageReport& report : reports)
+                {
+                    Log(Log::Level::INFO) << "Atlas page " << report.page << " (" << report.atlasFormat << ") from " <<
+                        report.filename << " (" << report.fileFormat << "): " <<
+                        report.width << "x" << report.height << ", " <<
+                        (report.pixelFormat == ouzel::graphics::PixelFormat::A8_UNORM ? "A8" : "RGBA8") <<
+                        (report.mipmaps ? " with mipmaps, " : ", ") <<
+                        report.memory << " bytes instead of " << report.fullMemory;
+                }
+                break;
+            }
             default:
                 break;
         }
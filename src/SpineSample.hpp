@@ -20,8 +20,8 @@ protected:
     ouzel::scene::Actor cameraActor;
     ouzel::scene::Camera camera;
     ouzel::scene::Scene scene;
-    ouzel::assets::Bundle bundle;
 
+    std::unique_ptr<spine::SpineWorld> spineWorld;
     std::unique_ptr<spine::SpineDrawable> spineBoy;
     ouzel::scene::Actor actor;
 
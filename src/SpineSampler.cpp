@@ -0,0 +1,389 @@
+// Copyright (C) 2017 Elviss Strazdins
+
+#include <algorithm>
+#include <chrono>
+#include "SpineSampler.hpp"
+#include "SpineCompression.hpp"
+#include "SpineCurves.hpp"
+#include "spine/spine.h"
+#include "spine/extension.h"
+
+// spine-c allocates a vtable for every timeline, so it is replaced with one that also holds the original apply and the timeline index
+typedef struct SamplerVtable
+{
+    _spTimelineVtable super;
+    void (*apply) (const spTimeline* self, spSkeleton* skeleton, float lastTime, float time, spEvent** firedEvents, int* eventsCount, float alpha, spMixPose pose, spMixDirection direction);
+    uint32_t index;
+    spTimelineType type;
+    const spine::CompressedTimeline* compressed;
+} SamplerVtable;
+
+static const int MAX_ENTRIES = 8;
+
+static spine::Sampler* currentSampler = nullptr;
+
+static int getTimelineEntries(spTimelineType type)
+{
+    switch (type)
+    {
+        case SP_TIMELINE_ROTATE:
+        case SP_TIMELINE_PATHCONSTRAINTPOSITION:
+        case SP_TIMELINE_PATHCONSTRAINTSPACING:
+            return 2;
+        case SP_TIMELINE_TRANSLATE:
+        case SP_TIMELINE_SCALE:
+        case SP_TIMELINE_SHEAR:
+        case SP_TIMELINE_IKCONSTRAINT:
+        case SP_TIMELINE_PATHCONSTRAINTMIX:
+            return 3;
+        case SP_TIMELINE_COLOR:
+        case SP_TIMELINE_TRANSFORMCONSTRAINT:
+            return 5;
+        case SP_TIMELINE_TWOCOLOR:
+            return 8;
+        default:
+            return 1;
+    }
+}
+
+// The original apply is called with the keyframe arrays narrowed to the two keyframes around the time,
+// so its binary search finishes immediately and the interpolation is left untouched
+static void applySampled(const spTimeline* self, spSkeleton* skeleton, float lastTime, float time, spEvent** firedEvents, int* eventsCount, float alpha, spMixPose pose, spMixDirection direction)
+{
+    const SamplerVtable* vtable = reinterpret_cast<const SamplerVtable*>(self->vtable);
+    spTimeline* timeline = const_cast<spTimeline*>(self);
+
+    if (const spine::CompressedTimeline* compressed = vtable->compressed)
+    {
+        // compressed timelines only keep the decoded keyframes around the time for the duration of the apply
+        int frame = currentSampler ? currentSampler->findFrame(vtable->index, *compressed, time) : -1;
+        if (frame < 0) frame = compressed->search(time);
+
+        float frames[2 * MAX_ENTRIES];
+        float curve[spine::CURVE_SIZE];
+        compressed->decode(frame, frames, curve);
+
+        spBaseTimeline* baseTimeline = SUB_CAST(spBaseTimeline, timeline);
+        CONST_CAST(float*, baseTimeline->frames) = frames;
+        CONST_CAST(int, baseTimeline->framesCount) = 2 * compressed->getEntries();
+        baseTimeline->super.curves = curve;
+
+        vtable->apply(self, skeleton, lastTime, time, firedEvents, eventsCount, alpha, pose, direction);
+
+        CONST_CAST(float*, baseTimeline->frames) = nullptr;
+        CONST_CAST(int, baseTimeline->framesCount) = 0;
+        baseTimeline->super.curves = nullptr;
+        return;
+    }
+
+    if (currentSampler)
+    {
+        switch (vtable->type)
+        {
+            case SP_TIMELINE_ATTACHMENT:
+            {
+                spAttachmentTimeline* attachmentTimeline = SUB_CAST(spAttachmentTimeline, timeline);
+                int frame = currentSampler->findFrame(vtable->index, attachmentTimeline->frames, attachmentTimeline->framesCount, 1, time);
+                if (frame < 0) break;
+
+                float* frames = attachmentTimeline->frames;
+                int framesCount = attachmentTimeline->framesCount;
+                const char** attachmentNames = attachmentTimeline->attachmentNames;
+
+                CONST_CAST(float*, attachmentTimeline->frames) = frames + frame;
+                CONST_CAST(int, attachmentTimeline->framesCount) = 2;
+                CONST_CAST(const char**, attachmentTimeline->attachmentNames) = attachmentNames + frame;
+
+                vtable->apply(self, skeleton, lastTime, time, firedEvents, eventsCount, alpha, pose, direction);
+
+                CONST_CAST(float*, attachmentTimeline->frames) = frames;
+                CONST_CAST(int, attachmentTimeline->framesCount) = framesCount;
+                CONST_CAST(const char**, attachmentTimeline->attachmentNames) = attachmentNames;
+                return;
+            }
+            case SP_TIMELINE_DRAWORDER:
+            {
+                spDrawOrderTimeline* drawOrderTimeline = SUB_CAST(spDrawOrderTimeline, timeline);
+                int frame = currentSampler->findFrame(vtable->index, drawOrderTimeline->frames, drawOrderTimeline->framesCount, 1, time);
+                if (frame < 0) break;
+
+                float* frames = drawOrderTimeline->frames;
+                int framesCount = drawOrderTimeline->framesCount;
+                const int** drawOrders = drawOrderTimeline->drawOrders;
+
+                CONST_CAST(float*, drawOrderTimeline->frames) = frames + frame;
+                CONST_CAST(int, drawOrderTimeline->framesCount) = 2;
+                CONST_CAST(const int**, drawOrderTimeline->drawOrders) = drawOrders + frame;
+
+                vtable->apply(self, skeleton, lastTime, time, firedEvents, eventsCount, alpha, pose, direction);
+
+                CONST_CAST(float*, drawOrderTimeline->frames) = frames;
+                CONST_CAST(int, drawOrderTimeline->framesCount) = framesCount;
+                CONST_CAST(const int**, drawOrderTimeline->drawOrders) = drawOrders;
+                return;
+            }
+            case SP_TIMELINE_DEFORM:
+            {
+                spDeformTimeline* deformTimeline = SUB_CAST(spDeformTimeline, timeline);
+                int frame = currentSampler->findFrame(vtable->index, deformTimeline->frames, deformTimeline->framesCount, 1, time);
+                if (frame < 0) break;
+
+                float* frames = deformTimeline->frames;
+                int framesCount = deformTimeline->framesCount;
+                const float** frameVertices = deformTimeline->frameVertices;
+                float* curves = deformTimeline->super.curves;
+
+                CONST_CAST(float*, deformTimeline->frames) = frames + frame;
+                CONST_CAST(int, deformTimeline->framesCount) = 2;
+                CONST_CAST(const float**, deformTimeline->frameVertices) = frameVertices + frame;
+                deformTimeline->super.curves = curves + frame * spine::CURVE_SIZE;
+
+                vtable->apply(self, skeleton, lastTime, time, firedEvents, eventsCount, alpha, pose, direction);
+
+                CONST_CAST(float*, deformTimeline->frames) = frames;
+                CONST_CAST(int, deformTimeline->framesCount) = framesCount;
+                CONST_CAST(const float**, deformTimeline->frameVertices) = frameVertices;
+                deformTimeline->super.curves = curves;
+                return;
+            }
+            case SP_TIMELINE_EVENT:
+                // events are fired for the whole range between the last and the current time
+                break;
+            default:
+            {
+                // all the remaining timelines share the layout of spBaseTimeline up to the frames
+                spBaseTimeline* baseTimeline = SUB_CAST(spBaseTimeline, timeline);
+                int entries = getTimelineEntries(vtable->type);
+                int frame = currentSampler->findFrame(vtable->index, baseTimeline->frames, baseTimeline->framesCount, entries, time);
+                if (frame < 0) break;
+
+                float* frames = baseTimeline->frames;
+                int framesCount = baseTimeline->framesCount;
+                float* curves = baseTimeline->super.curves;
+
+                CONST_CAST(float*, baseTimeline->frames) = frames + frame * entries;
+                CONST_CAST(int, baseTimeline->framesCount) = 2 * entries;
+                baseTimeline->super.curves = curves + frame * spine::CURVE_SIZE;
+
+                vtable->apply(self, skeleton, lastTime, time, firedEvents, eventsCount, alpha, pose, direction);
+
+                CONST_CAST(float*, baseTimeline->frames) = frames;
+                CONST_CAST(int, baseTimeline->framesCount) = framesCount;
+                baseTimeline->super.curves = curves;
+                return;
+            }
+        }
+    }
+
+    vtable->apply(self, skeleton, lastTime, time, firedEvents, eventsCount, alpha, pose, direction);
+}
+
+namespace spine
+{
+    Sampler::Scope::Scope(Sampler& sampler):
+        previous(currentSampler)
+    {
+        currentSampler = &sampler;
+    }
+
+    Sampler::Scope::~Scope()
+    {
+        currentSampler = previous;
+    }
+
+    uint32_t Sampler::install(spSkeletonData* skeletonData)
+    {
+        uint32_t index = 0;
+
+        for (int a = 0; a < skeletonData->animationsCount; ++a)
+            index = install(skeletonData->animations[a], index);
+
+        return index;
+    }
+
+    uint32_t Sampler::install(spAnimation* animation, uint32_t firstIndex)
+    {
+        uint32_t index = firstIndex;
+
+        for (int t = 0; t < animation->timelinesCount; ++t)
+        {
+            spTimeline* timeline = animation->timelines[t];
+            _spTimelineVtable* originalVtable = VTABLE(spTimeline, timeline);
+
+            SamplerVtable* vtable = NEW(SamplerVtable);
+            vtable->super = *originalVtable;
+            vtable->super.apply = applySampled;
+            vtable->apply = originalVtable->apply;
+            vtable->index = index++;
+            vtable->type = timeline->type;
+            vtable->compressed = nullptr;
+
+            // spine-c frees the vtable together with the timeline
+            CONST_CAST(void*, timeline->vtable) = vtable;
+            FREE(originalVtable);
+        }
+
+        return index;
+    }
+
+    bool Sampler::setCompressedTimeline(spTimeline* timeline, const CompressedTimeline* compressed)
+    {
+        if (VTABLE(spTimeline, timeline)->apply != applySampled) return false;
+
+        // spAnimationState reads the keyframes of rotate timelines directly while mixing
+        if (timeline->type == SP_TIMELINE_ROTATE) return false;
+
+        SamplerVtable* vtable = reinterpret_cast<SamplerVtable*>(VTABLE(spTimeline, timeline));
+        if (vtable->compressed) return false;
+
+        vtable->compressed = compressed;
+
+        spBaseTimeline* baseTimeline = SUB_CAST(spBaseTimeline, timeline);
+        FREE(baseTimeline->frames);
+        FREE(baseTimeline->super.curves);
+        CONST_CAST(float*, baseTimeline->frames) = nullptr;
+        CONST_CAST(int, baseTimeline->framesCount) = 0;
+        baseTimeline->super.curves = nullptr;
+
+        return true;
+    }
+
+    const CompressedTimeline* Sampler::getCompressedTimeline(const spTimeline* timeline)
+    {
+        if (VTABLE(spTimeline, timeline)->apply != applySampled) return nullptr;
+
+        return reinterpret_cast<const SamplerVtable*>(timeline->vtable)->compressed;
+    }
+
+    Sampler* Sampler::getCurrent()
+    {
+        return currentSampler;
+    }
+
+    void Sampler::setTimelineCount(uint32_t timelineCount)
+    {
+        cursors.resize(timelineCount, -1);
+    }
+
+    void Sampler::reset()
+    {
+        std::fill(cursors.begin(), cursors.end(), -1);
+    }
+
+    int Sampler::findFrame(uint32_t timelineIndex, const float* frames, int framesCount, int entries, float time)
+    {
+        return findFrame(timelineIndex, framesCount / entries, [frames, entries](int frame) {
+            return frames[frame * entries];
+        }, time);
+    }
+
+    int Sampler::findFrame(uint32_t timelineIndex, const CompressedTimeline& timeline, float time)
+    {
+        return findFrame(timelineIndex, timeline.getFrameCount(), [&timeline](int frame) {
+            return timeline.getTime(frame);
+        }, time);
+    }
+
+    template<typename GetTime>
+    int Sampler::findFrame(uint32_t timelineIndex, int frameCount, const GetTime& getTime, float time)
+    {
+        // the first and the last keyframe are handled without a search
+        if (frameCount < 3 || timelineIndex >= cursors.size()) return -1;
+        if (time < getTime(0) || time >= getTime(frameCount - 1)) return -1;
+
+        int32_t& cursor = cursors[timelineIndex];
+
+        if (cursor >= 0 && cursor < frameCount - 1 && getTime(cursor) <= time)
+        {
+            for (int walk = 0; walk < MAX_WALK; ++walk)
+            {
+                if (time < getTime(cursor + 1))
+                {
+                    ++hits;
+                    return cursor;
+                }
+
+                ++cursor;
+            }
+        }
+
+        ++searches;
+
+        int low = 0;
+        int high = frameCount - 2;
+
+        while (low < high)
+        {
+            int middle = (low + high + 1) / 2;
+
+            if (getTime(middle) <= time)
+                low = middle;
+            else
+                high = middle - 1;
+        }
+
+        cursor = low;
+
+        return cursor;
+    }
+
+    std::vector<SamplingBenchmark> benchmarkSampling(spSkeletonData* skeletonData, uint32_t timelineCount, uint32_t frameCount)
+    {
+        std::vector<SamplingBenchmark> results;
+
+        spSkeleton* skeleton = spSkeleton_create(skeletonData);
+        Sampler sampler;
+        sampler.setTimelineCount(timelineCount);
+
+        const float timeStep = 1.0f / 60.0f;
+
+        for (int a = 0; a < skeletonData->animationsCount; ++a)
+        {
+            spAnimation* animation = skeletonData->animations[a];
+
+            SamplingBenchmark result;
+            result.animation = animation->name;
+            result.timelineCount = static_cast<uint32_t>(animation->timelinesCount);
+
+            for (int pass = 0; pass < 2; ++pass)
+            {
+                spSkeleton_setToSetupPose(skeleton);
+                sampler.reset();
+                sampler.resetCounters();
+
+                Sampler* previousSampler = currentSampler;
+                currentSampler = (pass == 0) ? nullptr : &sampler;
+
+                float time = 0.0f;
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+                for (uint32_t frame = 0; frame < frameCount; ++frame)
+                {
+                    float lastTime = time;
+                    time += timeStep;
+                    spAnimation_apply(animation, skeleton, lastTime, time, 1, nullptr, nullptr, 1.0f, SP_MIX_POSE_CURRENT, SP_MIX_DIRECTION_IN);
+                }
+
+                uint64_t duration = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+
+                currentSampler = previousSampler;
+
+                if (pass == 0)
+                    result.searchDuration = frameCount ? duration / frameCount : 0;
+                else
+                {
+                    result.cursorDuration = frameCount ? duration / frameCount : 0;
+
+                    uint64_t total = sampler.getHits() + sampler.getSearches();
+                    result.hitRate = total ? static_cast<float>(sampler.getHits()) / static_cast<float>(total) : 0.0f;
+                }
+            }
+
+            results.push_back(result);
+        }
+
+        spSkeleton_dispose(skeleton);
+
+        return results;
+    }
+}
@@ -0,0 +1,89 @@
+// Copyright (C) 2017 Elviss Strazdins
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct spSkeletonData;
+struct spTimeline;
+struct spAnimation;
+
+namespace spine
+{
+    class CompressedTimeline;
+
+    // Remembers the keyframe every timeline was last sampled at, so that forward playback
+    // walks from it instead of binary searching the keyframes on every apply
+    //
+    // While a timeline is applied in a scope, its keyframe arrays in the shared skeleton data point
+    // to the two keyframes around the time and are restored after the spine-c apply returns. The
+    // current sampler is global too, so skeletons of hooked skeleton data may only be animated from
+    // one thread, with or without a sampler.
+    class Sampler
+    {
+    public:
+        // makes the sampler used by the timelines applied until the scope ends
+        class Scope
+        {
+        public:
+            explicit Scope(Sampler& sampler);
+            ~Scope();
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            Sampler* previous;
+        };
+
+        // number of keyframes to walk forward before falling back to a binary search
+        static const int MAX_WALK = 4;
+
+        // hooks the apply function of every timeline in the skeleton data, returns the number of timelines
+        static uint32_t install(spSkeletonData* skeletonData);
+        // hooks an animation loaded later, its timelines are numbered from firstIndex, returns the next free index
+        static uint32_t install(spAnimation* animation, uint32_t firstIndex);
+        // releases the keyframes of the timeline and plays it from the compressed one instead, rotate timelines
+        // can't be replaced
+        static bool setCompressedTimeline(spTimeline* timeline, const CompressedTimeline* compressed);
+        static const CompressedTimeline* getCompressedTimeline(const spTimeline* timeline);
+        static Sampler* getCurrent();
+
+        // keeps the cursors of existing timelines, so it can be called whenever animations are loaded
+        void setTimelineCount(uint32_t timelineCount);
+        // forgets all cursors, must be called on seeks
+        void reset();
+
+        // index of the keyframe at or before the time, -1 if the timeline doesn't need a search
+        int findFrame(uint32_t timelineIndex, const float* frames, int framesCount, int entries, float time);
+        int findFrame(uint32_t timelineIndex, const CompressedTimeline& timeline, float time);
+
+        uint64_t getHits() const { return hits; }
+        uint64_t getSearches() const { return searches; }
+        void resetCounters() { hits = searches = 0; }
+
+    private:
+        template<typename GetTime>
+        int findFrame(uint32_t timelineIndex, int frameCount, const GetTime& getTime, float time);
+
+        std::vector<int32_t> cursors;
+        uint64_t hits = 0;
+        uint64_t searches = 0;
+    };
+
+    struct SamplingBenchmark
+    {
+        std::string animation;
+        uint32_t timelineCount = 0;
+        // average time of one spAnimation_apply, in nanoseconds
+        uint64_t searchDuration = 0;
+        uint64_t cursorDuration = 0;
+        float hitRate = 0.0f;
+    };
+
+    // plays every animation of the skeleton data forward at 60 fps with and without a sampler, animations
+    // loaded on demand must be loaded first
+    std::vector<SamplingBenchmark> benchmarkSampling(spSkeletonData* skeletonData, uint32_t timelineCount, uint32_t frameCount);
+}
@@ -0,0 +1,447 @@
+// Copyright (C) 2017 Elviss Strazdins
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include "SpineSnapshot.hpp"
+#include "SpineData.hpp"
+#include "spine/spine.h"
+#include "spine/extension.h"
+
+enum EntryLink
+{
+    LINK_CURRENT,
+    LINK_MIXING_FROM,
+    LINK_NEXT
+};
+
+// the float fields of spTrackEntry that are saved, everything else is derived from the animations
+static float spTrackEntry::* const ENTRY_VALUES[] = {
+    &spTrackEntry::eventThreshold, &spTrackEntry::attachmentThreshold, &spTrackEntry::drawOrderThreshold,
+    &spTrackEntry::animationStart, &spTrackEntry::animationEnd, &spTrackEntry::animationLast, &spTrackEntry::nextAnimationLast,
+    &spTrackEntry::delay, &spTrackEntry::trackTime, &spTrackEntry::trackLast, &spTrackEntry::nextTrackLast, &spTrackEntry::trackEnd, &spTrackEntry::timeScale,
+    &spTrackEntry::alpha, &spTrackEntry::mixTime, &spTrackEntry::mixDuration, &spTrackEntry::interruptAlpha, &spTrackEntry::totalAlpha
+};
+
+static const size_t ENTRY_VALUE_COUNT = sizeof(ENTRY_VALUES) / sizeof(ENTRY_VALUES[0]);
+
+struct SnapshotHeader
+{
+    uint32_t boneCount;
+    uint32_t slotCount;
+    uint32_t entryCount;
+    uint32_t rotationCount;
+    float skeletonTime;
+    float timeScale;
+};
+
+struct BoneSnapshot
+{
+    float x, y, rotation, scaleX, scaleY, shearX, shearY;
+};
+
+struct SlotSnapshot
+{
+    float color[4];
+    float darkColor[3];
+    uint32_t attachment;
+};
+
+struct EntrySnapshot
+{
+    int32_t animation;
+    uint16_t trackIndex;
+    uint8_t link;
+    uint8_t loop;
+    float values[ENTRY_VALUE_COUNT];
+    uint32_t rotationCount;
+};
+
+// offsets of the arrays following the header
+struct SnapshotLayout
+{
+    size_t bones;
+    size_t slots;
+    size_t drawOrder;
+    size_t entries;
+    size_t rotations;
+    size_t size;
+};
+
+static SnapshotLayout getLayout(const SnapshotHeader& header)
+{
+    SnapshotLayout layout;
+    layout.bones = sizeof(SnapshotHeader);
+    layout.slots = layout.bones + header.boneCount * sizeof(BoneSnapshot);
+    layout.drawOrder = layout.slots + header.slotCount * sizeof(SlotSnapshot);
+    layout.entries = (layout.drawOrder + header.slotCount * sizeof(uint16_t) + 3) & ~static_cast<size_t>(3);
+    layout.rotations = layout.entries + header.entryCount * sizeof(EntrySnapshot);
+    layout.size = layout.rotations + header.rotationCount * sizeof(float);
+    return layout;
+}
+
+// visits the entries of every track in snapshot order: the current entry, the entries it mixes from and the queued entries
+template<class F>
+static void forEachEntry(const spAnimationState* animationState, const F& function)
+{
+    for (int t = 0; t < animationState->tracksCount; ++t)
+    {
+        spTrackEntry* current = animationState->tracks[t];
+        if (!current) continue;
+
+        function(current, LINK_CURRENT);
+
+        for (spTrackEntry* entry = current->mixingFrom; entry; entry = entry->mixingFrom)
+            function(entry, LINK_MIXING_FROM);
+
+        for (spTrackEntry* entry = current->next; entry; entry = entry->next)
+            function(entry, LINK_NEXT);
+    }
+}
+
+// recreates the track entries of the snapshot, their fields are overwritten afterwards
+static void rebuildTracks(spine::SpineData& data, spAnimationState* animationState, const EntrySnapshot* entries, uint32_t entryCount)
+{
+    // no events are reported for entries that are replaced by the snapshot
+    spAnimationStateListener listener = animationState->listener;
+    animationState->listener = nullptr;
+
+    spAnimationState_clearTracks(animationState);
+
+    for (uint32_t first = 0; first < entryCount;)
+    {
+        uint32_t queued = first + 1;
+        while (queued < entryCount && entries[queued].link == LINK_MIXING_FROM) ++queued;
+
+        uint32_t end = queued;
+        while (end < entryCount && entries[end].link == LINK_NEXT) ++end;
+
+        int trackIndex = entries[first].trackIndex;
+
+        // setting the deepest entry first makes every entry the one the next mixes from
+        for (uint32_t e = queued; e-- > first;)
+        {
+            spTrackEntry* entry = spAnimationState_setAnimation(animationState, trackIndex, data.getAnimation(entries[e].animation), entries[e].loop);
+            // spine replaces entries that were never applied instead of mixing from them
+            entry->nextTrackLast = 0.0f;
+        }
+
+        for (uint32_t e = queued; e < end; ++e)
+            spAnimationState_addAnimation(animationState, trackIndex, data.getAnimation(entries[e].animation), entries[e].loop, 0.0f);
+
+        first = end;
+    }
+
+    animationState->listener = listener;
+}
+
+namespace spine
+{
+    void Snapshot::capture(const SpineData& data, const spSkeleton* skeleton, const spAnimationState* animationState)
+    {
+        SnapshotHeader header;
+        header.boneCount = static_cast<uint32_t>(skeleton->bonesCount);
+        header.slotCount = static_cast<uint32_t>(skeleton->slotsCount);
+        header.entryCount = 0;
+        header.rotationCount = 0;
+        header.skeletonTime = skeleton->time;
+        header.timeScale = animationState->timeScale;
+
+        forEachEntry(animationState, [&header](const spTrackEntry* entry, EntryLink) {
+            ++header.entryCount;
+            header.rotationCount += static_cast<uint32_t>(entry->timelinesRotationCount);
+        });
+
+        SnapshotLayout layout = getLayout(header);
+        size = layout.size;
+        if (buffer.size() < size) buffer.resize(size);
+
+        *get<SnapshotHeader>(0) = header;
+
+        BoneSnapshot* bones = get<BoneSnapshot>(layout.bones);
+
+        for (uint32_t i = 0; i < header.boneCount; ++i)
+        {
+            const spBone* bone = skeleton->bones[i];
+            bones[i] = {bone->x, bone->y, bone->rotation, bone->scaleX, bone->scaleY, bone->shearX, bone->shearY};
+        }
+
+        SlotSnapshot* slots = get<SlotSnapshot>(layout.slots);
+
+        for (uint32_t i = 0; i < header.slotCount; ++i)
+        {
+            const spSlot* slot = skeleton->slots[i];
+            SlotSnapshot& slotSnapshot = slots[i];
+
+            slotSnapshot.color[0] = slot->color.r;
+            slotSnapshot.color[1] = slot->color.g;
+            slotSnapshot.color[2] = slot->color.b;
+            slotSnapshot.color[3] = slot->color.a;
+
+            if (slot->darkColor)
+            {
+                slotSnapshot.darkColor[0] = slot->darkColor->r;
+                slotSnapshot.darkColor[1] = slot->darkColor->g;
+                slotSnapshot.darkColor[2] = slot->darkColor->b;
+            }
+            else
+                slotSnapshot.darkColor[0] = slotSnapshot.darkColor[1] = slotSnapshot.darkColor[2] = 0.0f;
+
+            slotSnapshot.attachment = data.getAttachmentIndex(slot->attachment);
+        }
+
+        uint16_t* drawOrder = get<uint16_t>(layout.drawOrder);
+
+        for (uint32_t i = 0; i < header.slotCount; ++i)
+            drawOrder[i] = static_cast<uint16_t>(skeleton->drawOrder[i]->data->index);
+
+        EntrySnapshot* entrySnapshot = get<EntrySnapshot>(layout.entries);
+        float* rotations = get<float>(layout.rotations);
+
+        forEachEntry(animationState, [&](const spTrackEntry* entry, EntryLink link) {
+            entrySnapshot->animation = data.getAnimationIndex(entry->animation);
+            entrySnapshot->trackIndex = static_cast<uint16_t>(entry->trackIndex);
+            entrySnapshot->link = static_cast<uint8_t>(link);
+            entrySnapshot->loop = entry->loop ? 1 : 0;
+
+            for (size_t v = 0; v < ENTRY_VALUE_COUNT; ++v)
+                entrySnapshot->values[v] = entry->*ENTRY_VALUES[v];
+
+            entrySnapshot->rotationCount = static_cast<uint32_t>(entry->timelinesRotationCount);
+            std::copy(entry->timelinesRotation, entry->timelinesRotation + entry->timelinesRotationCount, rotations);
+            rotations += entry->timelinesRotationCount;
+
+            ++entrySnapshot;
+        });
+    }
+
+    bool Snapshot::restore(SpineData& data, spSkeleton* skeleton, spAnimationState* animationState) const
+    {
+        if (size < sizeof(SnapshotHeader)) return false;
+
+        const SnapshotHeader& header = *get<SnapshotHeader>(0);
+
+        if (header.boneCount != static_cast<uint32_t>(skeleton->bonesCount) ||
+            header.slotCount != static_cast<uint32_t>(skeleton->slotsCount))
+            return false;
+
+        SnapshotLayout layout = getLayout(header);
+        if (layout.size != size) return false;
+
+        const BoneSnapshot* bones = get<BoneSnapshot>(layout.bones);
+        const SlotSnapshot* slots = get<SlotSnapshot>(layout.slots);
+        const uint16_t* drawOrder = get<uint16_t>(layout.drawOrder);
+        const EntrySnapshot* entries = get<EntrySnapshot>(layout.entries);
+        const float* rotations = get<float>(layout.rotations);
+
+        // validate everything before touching the skeleton
+        uint64_t rotationCount = 0;
+
+        for (uint32_t i = 0; i < header.slotCount; ++i)
+        {
+            if (drawOrder[i] >= header.slotCount) return false;
+            if (slots[i].attachment != SpineData::NO_ATTACHMENT && slots[i].attachment >= data.getAttachmentCount()) return false;
+        }
+
+        for (uint32_t i = 0; i < header.entryCount; ++i)
+        {
+            const EntrySnapshot& entry = entries[i];
+
+            if (entry.animation < 0 || entry.animation >= data.getAnimationCount()) return false;
+            if (entry.link > LINK_NEXT) return false;
+            if (i == 0 && entry.link != LINK_CURRENT) return false;
+            if (i > 0 && entry.link == LINK_CURRENT)
+            {
+                // one current entry per track, in track order
+                if (entry.trackIndex <= entries[i - 1].trackIndex) return false;
+            }
+            else if (i > 0)
+            {
+                if (entry.trackIndex != entries[i - 1].trackIndex) return false;
+                if (entry.link == LINK_MIXING_FROM && entries[i - 1].link == LINK_NEXT) return false;
+            }
+
+            rotationCount += entry.rotationCount;
+        }
+
+        if (rotationCount != header.rotationCount) return false;
+
+        // animations loaded on demand are only decoded once the rest of the snapshot is valid
+        std::vector<spAnimation*> loadedAnimations;
+
+        for (uint32_t i = 0; i < header.entryCount; ++i)
+        {
+            bool loaded = data.isAnimationLoaded(entries[i].animation);
+            spAnimation* animation = data.getAnimation(entries[i].animation);
+
+            if (animation && !loaded) loadedAnimations.push_back(animation);
+
+            // spine-c only allocates the rotations of entries without any and indexes them by timeline
+            if (!animation || (entries[i].rotationCount != 0 &&
+                               entries[i].rotationCount != static_cast<uint32_t>(animation->timelinesCount) * 2))
+            {
+                for (spAnimation* loadedAnimation : loadedAnimations)
+                    data.unloadAnimation(std::string(loadedAnimation->name));
+
+                return false;
+            }
+        }
+
+        for (uint32_t i = 0; i < header.boneCount; ++i)
+        {
+            spBone* bone = skeleton->bones[i];
+            const BoneSnapshot& boneSnapshot = bones[i];
+
+            bone->x = boneSnapshot.x;
+            bone->y = boneSnapshot.y;
+            bone->rotation = boneSnapshot.rotation;
+            bone->scaleX = boneSnapshot.scaleX;
+            bone->scaleY = boneSnapshot.scaleY;
+            bone->shearX = boneSnapshot.shearX;
+            bone->shearY = boneSnapshot.shearY;
+        }
+
+        for (uint32_t i = 0; i < header.slotCount; ++i)
+        {
+            spSlot* slot = skeleton->slots[i];
+            const SlotSnapshot& slotSnapshot = slots[i];
+
+            slot->color.r = slotSnapshot.color[0];
+            slot->color.g = slotSnapshot.color[1];
+            slot->color.b = slotSnapshot.color[2];
+            slot->color.a = slotSnapshot.color[3];
+
+            if (slot->darkColor)
+            {
+                slot->darkColor->r = slotSnapshot.darkColor[0];
+                slot->darkColor->g = slotSnapshot.darkColor[1];
+                slot->darkColor->b = slotSnapshot.darkColor[2];
+            }
+
+            spAttachment* attachment = data.getAttachment(slotSnapshot.attachment);
+            if (slot->attachment != attachment) spSlot_setAttachment(slot, attachment);
+        }
+
+        for (uint32_t i = 0; i < header.slotCount; ++i)
+            skeleton->drawOrder[i] = skeleton->slots[drawOrder[i]];
+
+        skeleton->time = header.skeletonTime;
+        animationState->timeScale = header.timeScale;
+
+        // in-place restore is possible if the tracks hold the same animations in the same places
+        uint32_t index = 0;
+        bool matching = true;
+
+        forEachEntry(animationState, [&](const spTrackEntry* entry, EntryLink link) {
+            if (index < header.entryCount)
+            {
+                const EntrySnapshot& entrySnapshot = entries[index];
+
+                if (entrySnapshot.link != link ||
+                    entrySnapshot.trackIndex != entry->trackIndex ||
+                    data.getAnimation(entrySnapshot.animation) != entry->animation)
+                    matching = false;
+            }
+
+            ++index;
+        });
+
+        if (!matching || index != header.entryCount)
+            rebuildTracks(data, animationState, entries, header.entryCount);
+
+        const EntrySnapshot* entrySnapshot = entries;
+
+        forEachEntry(animationState, [&](spTrackEntry* entry, EntryLink) {
+            entry->loop = entrySnapshot->loop;
+
+            for (size_t v = 0; v < ENTRY_VALUE_COUNT; ++v)
+                entry->*ENTRY_VALUES[v] = entrySnapshot->values[v];
+
+            int count = static_cast<int>(entrySnapshot->rotationCount);
+
+            if (entry->timelinesRotationCount != count)
+            {
+                FREE(entry->timelinesRotation);
+                entry->timelinesRotation = count ? MALLOC(float, count) : nullptr;
+                entry->timelinesRotationCount = count;
+            }
+
+            std::copy(rotations, rotations + count, entry->timelinesRotation);
+            rotations += count;
+
+            ++entrySnapshot;
+        });
+
+        return true;
+    }
+
+    void Snapshot::setData(const uint8_t* data, size_t dataSize)
+    {
+        size = dataSize;
+        if (buffer.size() < size) buffer.resize(size);
+        if (size) std::memcpy(buffer.data(), data, size);
+    }
+
+    SnapshotBenchmark benchmarkSnapshots(SpineData& data, uint32_t iterations)
+    {
+        SnapshotBenchmark result;
+
+        spSkeletonData* skeletonData = data.getSkeletonData();
+        spAnimation* firstAnimation = data.getAnimation(0);
+        spAnimation* secondAnimation = data.getAnimation(data.getAnimationCount() > 1 ? 1 : 0);
+        if (!firstAnimation || !secondAnimation || !iterations) return result;
+
+        spSkeleton* skeleton = spSkeleton_create(skeletonData);
+        spAnimationStateData* animationStateData = spAnimationStateData_create(skeletonData);
+        animationStateData->defaultMix = 0.2f;
+        spAnimationState* animationState = spAnimationState_create(animationStateData);
+
+        // a mix in progress with a queued entry
+        spAnimationState_setAnimation(animationState, 0, firstAnimation, 1);
+        spAnimationState_update(animationState, 0.5f);
+        spAnimationState_apply(animationState, skeleton);
+        spAnimationState_setAnimation(animationState, 0, secondAnimation, 1);
+        spAnimationState_addAnimation(animationState, 0, firstAnimation, 1, 0.0f);
+        spAnimationState_update(animationState, 0.1f);
+        spAnimationState_apply(animationState, skeleton);
+
+        Snapshot snapshot;
+        snapshot.capture(data, skeleton, animationState);
+
+        result.size = snapshot.getSize();
+        result.entryCount = reinterpret_cast<const SnapshotHeader*>(snapshot.getData())->entryCount;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for (uint32_t i = 0; i < iterations; ++i)
+            snapshot.capture(data, skeleton, animationState);
+
+        result.captureDuration = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()) / iterations;
+
+        start = std::chrono::steady_clock::now();
+
+        for (uint32_t i = 0; i < iterations; ++i)
+            snapshot.restore(data, skeleton, animationState);
+
+        result.restoreDuration = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()) / iterations;
+
+        std::chrono::steady_clock::duration rebuildDuration(0);
+
+        for (uint32_t i = 0; i < iterations; ++i)
+        {
+            spAnimationState_setAnimation(animationState, 1, firstAnimation, 0);
+
+            start = std::chrono::steady_clock::now();
+            snapshot.restore(data, skeleton, animationState);
+            rebuildDuration += std::chrono::steady_clock::now() - start;
+        }
+
+        result.rebuildDuration = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(rebuildDuration).count()) / iterations;
+
+        spAnimationState_dispose(animationState);
+        spAnimationStateData_dispose(animationStateData);
+        spSkeleton_dispose(skeleton);
+
+        return result;
+    }
+}
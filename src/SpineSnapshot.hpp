@@ -0,0 +1,53 @@
+// Copyright (C) 2017 Elviss Strazdins
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct spSkeleton;
+struct spAnimationState;
+
+namespace spine
+{
+    class SpineData;
+
+    // Animation state of a skeleton (bone poses, slot colors and attachments, draw order and all track
+    // entries with their mixes) in a flat buffer without pointers, so it can be copied with memcpy, sent
+    // over the network or saved and restored into any skeleton created from the same data
+    class Snapshot
+    {
+    public:
+        // the buffer only grows, so capturing every frame doesn't allocate once it is large enough
+        void capture(const SpineData& data, const spSkeleton* skeleton, const spAnimationState* animationState);
+
+        // returns false if the snapshot doesn't match the skeleton data, track entries are only
+        // reallocated if the tracks don't have the same animations as the snapshot
+        bool restore(SpineData& data, spSkeleton* skeleton, spAnimationState* animationState) const;
+
+        const uint8_t* getData() const { return buffer.data(); }
+        size_t getSize() const { return size; }
+        void setData(const uint8_t* data, size_t dataSize);
+
+    private:
+        template<class T> T* get(size_t offset) { return reinterpret_cast<T*>(buffer.data() + offset); }
+        template<class T> const T* get(size_t offset) const { return reinterpret_cast<const T*>(buffer.data() + offset); }
+
+        std::vector<uint8_t> buffer;
+        size_t size = 0;
+    };
+
+    struct SnapshotBenchmark
+    {
+        size_t size = 0;
+        uint32_t entryCount = 0;
+        // average time for one skeleton, in nanoseconds
+        uint64_t captureDuration = 0;
+        uint64_t restoreDuration = 0;
+        // restore after the tracks changed, which rebuilds the track entries
+        uint64_t rebuildDuration = 0;
+    };
+
+    // captures and restores a skeleton mixing between the first two animations of the data
+    SnapshotBenchmark benchmarkSnapshots(SpineData& data, uint32_t iterations);
+}
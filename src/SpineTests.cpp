@@ -0,0 +1,946 @@
+// Copyright (C) 2017 Elviss Strazdins
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "SpineTests.hpp"
+#include "SpineAtlasPage.hpp"
+#include "SpineCompression.hpp"
+#include "SpineHull.hpp"
+#include "SpineSampler.hpp"
+#include "spine/spine.h"
+#include "spine/extension.h"
+
+using namespace ouzel;
+
+static const float POSE_TOLERANCE = 0.0001f;
+
+static bool isNear(float a, float b)
+{
+    return std::fabs(a - b) <= POSE_TOLERANCE * std::max(1.0f, std::fabs(a));
+}
+
+static std::string getAttachmentName(const spSlot* slot)
+{
+    return slot->attachment ? slot->attachment->name : "";
+}
+
+// local and world transforms of the bones, slot colors, attachments, deform vertices and draw order
+static bool isSamePose(const spSkeleton* skeleton, const spSkeleton* otherSkeleton)
+{
+    if (skeleton->bonesCount != otherSkeleton->bonesCount || skeleton->slotsCount != otherSkeleton->slotsCount) return false;
+
+    for (int b = 0; b < skeleton->bonesCount; ++b)
+    {
+        const spBone* bone = skeleton->bones[b];
+        const spBone* otherBone = otherSkeleton->bones[b];
+
+        if (!isNear(bone->x, otherBone->x) || !isNear(bone->y, otherBone->y) ||
+            !isNear(bone->rotation, otherBone->rotation) ||
+            !isNear(bone->scaleX, otherBone->scaleX) || !isNear(bone->scaleY, otherBone->scaleY) ||
+            !isNear(bone->shearX, otherBone->shearX) || !isNear(bone->shearY, otherBone->shearY) ||
+            !isNear(bone->worldX, otherBone->worldX) || !isNear(bone->worldY, otherBone->worldY))
+            return false;
+    }
+
+    for (int i = 0; i < skeleton->slotsCount; ++i)
+    {
+        const spSlot* slot = skeleton->slots[i];
+        const spSlot* otherSlot = otherSkeleton->slots[i];
+
+        if (!isNear(slot->color.r, otherSlot->color.r) || !isNear(slot->color.g, otherSlot->color.g) ||
+            !isNear(slot->color.b, otherSlot->color.b) || !isNear(slot->color.a, otherSlot->color.a) ||
+            getAttachmentName(slot) != getAttachmentName(otherSlot) ||
+            slot->attachmentVerticesCount != otherSlot->attachmentVerticesCount ||
+            skeleton->drawOrder[i]->data->index != otherSkeleton->drawOrder[i]->data->index)
+            return false;
+
+        for (int v = 0; v < slot->attachmentVerticesCount; ++v)
+            if (!isNear(slot->attachmentVertices[v], otherSlot->attachmentVertices[v])) return false;
+    }
+
+    return true;
+}
+
+// the lazy loader decodes animations with its own copy of the spine-c binary reader,
+// so every animation has to pose the skeleton exactly like the one spine-c decoded
+static void testAnimationLoader(SpineTests& tests)
+{
+    spine::LoadSettings lazySettings;
+    lazySettings.lazyAnimations = true;
+
+    std::shared_ptr<spine::SpineData> eagerData = std::make_shared<spine::SpineData>("spineboy.atlas", "spineboy.skel");
+    std::shared_ptr<spine::SpineData> lazyData = std::make_shared<spine::SpineData>("spineboy.atlas", "spineboy.skel", lazySettings);
+
+    tests.check(eagerData->isLoaded() && lazyData->isLoaded(), "spineboy loads eagerly and lazily");
+    if (!eagerData->isLoaded() || !lazyData->isLoaded()) return;
+
+    tests.check(lazyData->getAnimationCount() == eagerData->getAnimationCount(), "lazy data indexes every animation");
+    tests.check(!lazyData->isAnimationLoaded(0), "lazy data doesn't decode animations up front");
+
+    spSkeleton* eagerSkeleton = spSkeleton_create(eagerData->getSkeletonData());
+    spSkeleton* lazySkeleton = spSkeleton_create(lazyData->getSkeletonData());
+    spEvent* eagerEvents[64];
+    spEvent* lazyEvents[64];
+
+    for (int32_t a = 0; a < eagerData->getAnimationCount() && a < lazyData->getAnimationCount(); ++a)
+    {
+        spAnimation* eagerAnimation = eagerData->getAnimation(a);
+        spAnimation* lazyAnimation = lazyData->getAnimation(a);
+
+        tests.check(lazyAnimation != nullptr, "animation " + std::to_string(a) + " decodes");
+        if (!eagerAnimation || !lazyAnimation) continue;
+
+        std::string name = eagerAnimation->name;
+        tests.check(name == lazyAnimation->name, name + " has the same name");
+        tests.check(eagerAnimation->duration == lazyAnimation->duration, name + " has the same duration");
+        tests.check(eagerAnimation->timelinesCount == lazyAnimation->timelinesCount, name + " has the same timelines");
+
+        bool posesMatch = true;
+        bool eventsMatch = true;
+        float lastTime = -1.0f;
+
+        for (int s = 0; s <= static_cast<int>(eagerAnimation->duration * 30.0f) + 1; ++s)
+        {
+            float time = std::min(static_cast<float>(s) / 30.0f, eagerAnimation->duration);
+            int eagerEventCount = 0;
+            int lazyEventCount = 0;
+
+            spSkeleton_setToSetupPose(eagerSkeleton);
+            spSkeleton_setToSetupPose(lazySkeleton);
+            spAnimation_apply(eagerAnimation, eagerSkeleton, lastTime, time, 0, eagerEvents, &eagerEventCount, 1.0f, SP_MIX_POSE_SETUP, SP_MIX_DIRECTION_IN);
+            spAnimation_apply(lazyAnimation, lazySkeleton, lastTime, time, 0, lazyEvents, &lazyEventCount, 1.0f, SP_MIX_POSE_SETUP, SP_MIX_DIRECTION_IN);
+            spSkeleton_updateWorldTransform(eagerSkeleton);
+            spSkeleton_updateWorldTransform(lazySkeleton);
+            lastTime = time;
+
+            posesMatch = posesMatch && isSamePose(eagerSkeleton, lazySkeleton);
+
+            eventsMatch = eventsMatch && eagerEventCount == lazyEventCount;
+
+            for (int e = 0; eventsMatch && e < eagerEventCount; ++e)
+            {
+                eventsMatch = std::string(eagerEvents[e]->data->name) == lazyEvents[e]->data->name &&
+                    eagerEvents[e]->time == lazyEvents[e]->time &&
+                    eagerEvents[e]->intValue == lazyEvents[e]->intValue &&
+                    eagerEvents[e]->floatValue == lazyEvents[e]->floatValue &&
+                    std::string(eagerEvents[e]->stringValue ? eagerEvents[e]->stringValue : "") ==
+                    (lazyEvents[e]->stringValue ? lazyEvents[e]->stringValue : "");
+            }
+        }
+
+        tests.check(posesMatch, name + " poses the skeleton like the spine-c reader");
+        tests.check(eventsMatch, name + " fires the same events as the spine-c reader");
+    }
+
+    spSkeleton_dispose(eagerSkeleton);
+    spSkeleton_dispose(lazySkeleton);
+
+    std::string firstAnimation = lazyData->getAnimation(0) ? lazyData->getAnimation(0)->name : "";
+    tests.check(lazyData->unloadAnimation(firstAnimation), "lazily loaded animations can be unloaded");
+    tests.check(!lazyData->isAnimationLoaded(0) && lazyData->hasAnimation(firstAnimation), "unloaded animations stay indexed");
+    tests.check(!eagerData->unloadAnimation(firstAnimation), "eagerly loaded animations stay loaded");
+}
+
+// the sampler narrows the keyframes spine-c searches, so the pose has to match plain spine-c
+// for forward playback, loop wraps, backward seeks and mixed tracks
+static void testSampler(SpineTests& tests)
+{
+    std::shared_ptr<spine::SpineData> data = std::make_shared<spine::SpineData>("spineboy.atlas", "spineboy.skel");
+
+    tests.check(data->isLoaded() && data->getAnimationCount() > 2, "spineboy loads for sampling");
+    if (!data->isLoaded() || data->getAnimationCount() < 3) return;
+
+    spSkeleton* skeleton = spSkeleton_create(data->getSkeletonData());
+    spSkeleton* sampledSkeleton = spSkeleton_create(data->getSkeletonData());
+    spine::Sampler sampler;
+    sampler.setTimelineCount(data->getTimelineCount());
+
+    for (int32_t a = 0; a < data->getAnimationCount(); ++a)
+    {
+        spAnimation* animation = data->getAnimation(a);
+        if (!animation) continue;
+
+        // two and a half loops at 60 fps, then a seek back to three quarters and one to a quarter
+        std::vector<float> times;
+        for (int s = 0; s <= static_cast<int>(animation->duration * 150.0f); ++s)
+            times.push_back(static_cast<float>(s) / 60.0f);
+        for (int s = 0; s < 10; ++s)
+            times.push_back(animation->duration * 0.75f + static_cast<float>(s) / 60.0f);
+        for (int s = 0; s < 10; ++s)
+            times.push_back(animation->duration * 0.25f + static_cast<float>(s) / 60.0f);
+
+        bool posesMatch = true;
+        float lastTime = -1.0f;
+        sampler.reset();
+        sampler.resetCounters();
+
+        for (float time : times)
+        {
+            spAnimation_apply(animation, skeleton, lastTime, time, 1, nullptr, nullptr, 1.0f, SP_MIX_POSE_SETUP, SP_MIX_DIRECTION_IN);
+
+            {
+                spine::Sampler::Scope samplerScope(sampler);
+                spAnimation_apply(animation, sampledSkeleton, lastTime, time, 1, nullptr, nullptr, 1.0f, SP_MIX_POSE_SETUP, SP_MIX_DIRECTION_IN);
+            }
+
+            spSkeleton_updateWorldTransform(skeleton);
+            spSkeleton_updateWorldTransform(sampledSkeleton);
+            lastTime = time;
+
+            posesMatch = posesMatch && isSamePose(skeleton, sampledSkeleton);
+        }
+
+        tests.check(posesMatch, std::string(animation->name) + " samples like spine-c");
+    }
+
+    tests.check(sampler.getHits() > 0, "sampler walks from the cached keyframes");
+
+    // a crossfade on the first track under a half transparent second track
+    spAnimationStateData* animationStateData = spAnimationStateData_create(data->getSkeletonData());
+    animationStateData->defaultMix = 0.25f;
+    spAnimationState* animationState = spAnimationState_create(animationStateData);
+    spAnimationState* sampledAnimationState = spAnimationState_create(animationStateData);
+
+    spSkeleton_setToSetupPose(skeleton);
+    spSkeleton_setToSetupPose(sampledSkeleton);
+    sampler.reset();
+
+    spAnimationState* animationStates[] = {animationState, sampledAnimationState};
+    for (spAnimationState* state : animationStates)
+    {
+        spAnimationState_setAnimation(state, 0, data->getAnimation(0), 1);
+        spAnimationState_setAnimation(state, 1, data->getAnimation(2), 1)->alpha = 0.5f;
+    }
+
+    bool posesMatch = true;
+
+    for (int frame = 0; frame < 180; ++frame)
+    {
+        for (spAnimationState* state : animationStates)
+        {
+            if (frame == 60) spAnimationState_setAnimation(state, 0, data->getAnimation(1), 1);
+            if (frame == 120) spAnimationState_getCurrent(state, 1)->trackTime = 0.1f;
+
+            spAnimationState_update(state, 1.0f / 60.0f);
+        }
+
+        spAnimationState_apply(animationState, skeleton);
+
+        {
+            spine::Sampler::Scope samplerScope(sampler);
+            spAnimationState_apply(sampledAnimationState, sampledSkeleton);
+        }
+
+        spSkeleton_updateWorldTransform(skeleton);
+        spSkeleton_updateWorldTransform(sampledSkeleton);
+
+        posesMatch = posesMatch && isSamePose(skeleton, sampledSkeleton);
+    }
+
+    tests.check(posesMatch, "mixed tracks sample like spine-c");
+
+    spAnimationState_dispose(sampledAnimationState);
+    spAnimationState_dispose(animationState);
+    spAnimationStateData_dispose(animationStateData);
+    spSkeleton_dispose(sampledSkeleton);
+    spSkeleton_dispose(skeleton);
+}
+
+// largest difference of the bone values two timelines of the same bone set at the time, scales relative
+// to the setup pose, float precision of the values is not counted
+static float getTimelineError(const spTimeline* timeline, const spTimeline* otherTimeline,
+                              spSkeleton* skeleton, spSkeleton* otherSkeleton, float time)
+{
+    spSkeleton_setToSetupPose(skeleton);
+    spSkeleton_setToSetupPose(otherSkeleton);
+    spTimeline_apply(timeline, skeleton, time, time, nullptr, nullptr, 1.0f, SP_MIX_POSE_SETUP, SP_MIX_DIRECTION_IN);
+    spTimeline_apply(otherTimeline, otherSkeleton, time, time, nullptr, nullptr, 1.0f, SP_MIX_POSE_SETUP, SP_MIX_DIRECTION_IN);
+
+    int boneIndex = reinterpret_cast<const spBaseTimeline*>(timeline)->boneIndex;
+    const spBone* bone = skeleton->bones[boneIndex];
+    const spBone* otherBone = otherSkeleton->bones[boneIndex];
+
+    float values[2][2];
+    float scales[2] = {1.0f, 1.0f};
+
+    switch (timeline->type)
+    {
+        case SP_TIMELINE_ROTATE:
+        {
+            float difference = std::fmod(bone->rotation - otherBone->rotation, 360.0f);
+            if (difference > 180.0f) difference -= 360.0f;
+            if (difference < -180.0f) difference += 360.0f;
+
+            return std::max(std::fabs(difference) - POSE_TOLERANCE * std::max(1.0f, std::fabs(bone->rotation)), 0.0f);
+        }
+        case SP_TIMELINE_TRANSLATE:
+            values[0][0] = bone->x; values[0][1] = bone->y;
+            values[1][0] = otherBone->x; values[1][1] = otherBone->y;
+            break;
+        case SP_TIMELINE_SCALE:
+            values[0][0] = bone->scaleX; values[0][1] = bone->scaleY;
+            values[1][0] = otherBone->scaleX; values[1][1] = otherBone->scaleY;
+            if (bone->data->scaleX != 0.0f) scales[0] = std::fabs(bone->data->scaleX);
+            if (bone->data->scaleY != 0.0f) scales[1] = std::fabs(bone->data->scaleY);
+            break;
+        case SP_TIMELINE_SHEAR:
+            values[0][0] = bone->shearX; values[0][1] = bone->shearY;
+            values[1][0] = otherBone->shearX; values[1][1] = otherBone->shearY;
+            break;
+        default:
+            return 0.0f;
+    }
+
+    float error = 0.0f;
+
+    for (int c = 0; c < 2; ++c)
+    {
+        float difference = std::fabs(values[0][c] - values[1][c]) / scales[c];
+        error = std::max(error, difference - POSE_TOLERANCE * std::max(1.0f, std::fabs(values[0][c])));
+    }
+
+    return error;
+}
+
+// compressed timelines stay within the tolerance everywhere and match the original at the keyframes they keep,
+// rotate timelines keep the spine-c layout that spAnimationState reads while mixing
+static void testCompression(SpineTests& tests)
+{
+    std::shared_ptr<spine::SpineData> data = std::make_shared<spine::SpineData>("spineboy.atlas", "spineboy.skel");
+    std::shared_ptr<spine::SpineData> compressedData = std::make_shared<spine::SpineData>("spineboy.atlas", "spineboy.skel");
+
+    tests.check(data->isLoaded() && compressedData->isLoaded(), "spineboy loads for compression");
+    if (!data->isLoaded() || !compressedData->isLoaded()) return;
+
+    spine::CompressionSettings settings;
+    std::vector<spine::CompressionReport> reports = compressedData->compressAnimations(settings);
+
+    uint32_t originalKeyframes = 0;
+    uint32_t compressedKeyframes = 0;
+    float maxRotationError = 0.0f;
+
+    for (const spine::CompressionReport& report : reports)
+    {
+        originalKeyframes += report.originalKeyframes;
+        compressedKeyframes += report.compressedKeyframes;
+        maxRotationError = std::max(maxRotationError, report.maxRotationError);
+    }
+
+    tests.check(reports.size() == static_cast<size_t>(data->getAnimationCount()), "every animation is compressed");
+    tests.check(compressedKeyframes < originalKeyframes, "compression removes keyframes");
+    tests.check(maxRotationError <= settings.rotationTolerance + POSE_TOLERANCE, "reported rotation error is within the tolerance");
+    tests.check(compressedData->compressAnimations(settings).empty(), "animations are only compressed once");
+
+    spSkeleton* skeleton = spSkeleton_create(data->getSkeletonData());
+    spSkeleton* compressedSkeleton = spSkeleton_create(compressedData->getSkeletonData());
+
+    for (int32_t a = 0; a < data->getAnimationCount(); ++a)
+    {
+        spAnimation* animation = data->getAnimation(a);
+        spAnimation* compressedAnimation = compressedData->getAnimation(a);
+        if (!animation || !compressedAnimation || animation->timelinesCount != compressedAnimation->timelinesCount) continue;
+
+        bool withinTolerance = true;
+        bool keyframesMatch = true;
+        bool rotateLayout = true;
+
+        for (int t = 0; t < animation->timelinesCount; ++t)
+        {
+            const spTimeline* timeline = animation->timelines[t];
+            const spTimeline* compressedTimeline = compressedAnimation->timelines[t];
+            float tolerance;
+            int entries = 3;
+
+            switch (timeline->type)
+            {
+                case SP_TIMELINE_ROTATE: tolerance = settings.rotationTolerance; entries = 2; break;
+                case SP_TIMELINE_TRANSLATE: tolerance = settings.translationTolerance; break;
+                case SP_TIMELINE_SCALE: tolerance = settings.scaleTolerance; break;
+                case SP_TIMELINE_SHEAR: tolerance = settings.rotationTolerance; break;
+                default: continue;
+            }
+
+            const spBaseTimeline* baseTimeline = reinterpret_cast<const spBaseTimeline*>(timeline);
+            const spBaseTimeline* compressedBaseTimeline = reinterpret_cast<const spBaseTimeline*>(compressedTimeline);
+            const spine::CompressedTimeline* compressed = spine::Sampler::getCompressedTimeline(compressedTimeline);
+
+            if (timeline->type == SP_TIMELINE_ROTATE)
+                rotateLayout = rotateLayout && compressedTimeline->type == SP_TIMELINE_ROTATE &&
+                    !compressed && compressedBaseTimeline->frames;
+
+            // keyframes left after compression, values are quantized to 16 bits of their range
+            std::vector<float> keyframeTimes;
+            float quantizationError = 0.0f;
+
+            if (compressed)
+            {
+                for (int frame = 0; frame < compressed->getFrameCount(); ++frame)
+                    keyframeTimes.push_back(compressed->getTime(frame));
+
+                for (int c = 1; c < entries; ++c)
+                {
+                    float minValue = baseTimeline->frames[c];
+                    float maxValue = minValue;
+
+                    for (int i = entries + c; i < baseTimeline->framesCount; i += entries)
+                    {
+                        minValue = std::min(minValue, baseTimeline->frames[i]);
+                        maxValue = std::max(maxValue, baseTimeline->frames[i]);
+                    }
+
+                    quantizationError = std::max(quantizationError, (maxValue - minValue) / 65535.0f / 2.0f);
+                }
+            }
+            else
+            {
+                for (int i = 0; i < compressedBaseTimeline->framesCount; i += entries)
+                    keyframeTimes.push_back(compressedBaseTimeline->frames[i]);
+            }
+
+            for (float time : keyframeTimes)
+                keyframesMatch = keyframesMatch &&
+                    getTimelineError(timeline, compressedTimeline, skeleton, compressedSkeleton, time) <= quantizationError;
+
+            // the original keyframes and samples at the rate used to measure the error
+            std::vector<float> times;
+            for (int i = 0; i < baseTimeline->framesCount; i += entries)
+                times.push_back(baseTimeline->frames[i]);
+            for (int s = 0; s <= static_cast<int>(animation->duration * settings.sampleRate); ++s)
+                times.push_back(static_cast<float>(s) / settings.sampleRate);
+
+            for (float time : times)
+                withinTolerance = withinTolerance &&
+                    getTimelineError(timeline, compressedTimeline, skeleton, compressedSkeleton, time) <= tolerance;
+        }
+
+        std::string name = animation->name;
+        tests.check(withinTolerance, name + " stays within the compression tolerance");
+        tests.check(keyframesMatch, name + " matches the original at the kept keyframes");
+        tests.check(rotateLayout, name + " keeps rotate timelines in the spine-c layout");
+    }
+
+    spSkeleton_dispose(compressedSkeleton);
+    spSkeleton_dispose(skeleton);
+}
+
+// a mix in progress with a queued entry, like benchmarkSnapshots
+static void playMix(spine::SpineData& data, spSkeleton* skeleton, spAnimationState* animationState)
+{
+    spAnimationState_setAnimation(animationState, 0, data.getAnimation(0), 1);
+    spAnimationState_update(animationState, 0.5f);
+    spAnimationState_apply(animationState, skeleton);
+    spAnimationState_setAnimation(animationState, 0, data.getAnimation(1), 1);
+    spAnimationState_addAnimation(animationState, 0, data.getAnimation(0), 1, 0.0f);
+    spAnimationState_update(animationState, 0.1f);
+    spAnimationState_apply(animationState, skeleton);
+}
+
+static void testSnapshots(SpineTests& tests)
+{
+    spine::LoadSettings lazySettings;
+    lazySettings.lazyAnimations = true;
+
+    std::shared_ptr<spine::SpineData> data = std::make_shared<spine::SpineData>("spineboy.atlas", "spineboy.skel");
+    std::shared_ptr<spine::SpineData> lazyData = std::make_shared<spine::SpineData>("spineboy.atlas", "spineboy.skel", lazySettings);
+
+    tests.check(data->isLoaded() && lazyData->isLoaded() && data->getAnimationCount() > 1, "spineboy loads for snapshots");
+    if (!data->isLoaded() || !lazyData->isLoaded() || data->getAnimationCount() < 2) return;
+
+    spAnimationStateData* animationStateData = spAnimationStateData_create(data->getSkeletonData());
+    animationStateData->defaultMix = 0.2f;
+    spSkeleton* skeleton = spSkeleton_create(data->getSkeletonData());
+    spAnimationState* animationState = spAnimationState_create(animationStateData);
+
+    spAnimationStateData* lazyAnimationStateData = spAnimationStateData_create(lazyData->getSkeletonData());
+    spSkeleton* lazySkeleton = spSkeleton_create(lazyData->getSkeletonData());
+    spAnimationState* lazyAnimationState = spAnimationState_create(lazyAnimationStateData);
+
+    playMix(*data, skeleton, animationState);
+
+    spine::Snapshot snapshot;
+    snapshot.capture(*data, skeleton, animationState);
+
+    // restoring into a fresh skeleton rebuilds the tracks, capturing it again gives the same bytes
+    spSkeleton* restoredSkeleton = spSkeleton_create(data->getSkeletonData());
+    spAnimationState* restoredAnimationState = spAnimationState_create(animationStateData);
+    spine::Snapshot restoredSnapshot;
+
+    tests.check(snapshot.restore(*data, restoredSkeleton, restoredAnimationState), "snapshot restores into a fresh skeleton");
+    restoredSnapshot.capture(*data, restoredSkeleton, restoredAnimationState);
+    tests.check(restoredSnapshot.getSize() == snapshot.getSize() &&
+                memcmp(restoredSnapshot.getData(), snapshot.getData(), snapshot.getSize()) == 0,
+                "restored snapshot captures the same state");
+
+    spine::Snapshot truncatedSnapshot;
+    truncatedSnapshot.setData(snapshot.getData(), snapshot.getSize() - 1);
+    tests.check(!truncatedSnapshot.restore(*data, restoredSkeleton, restoredAnimationState), "truncated snapshot is rejected");
+
+    // animations decoded for a snapshot that is accepted stay loaded
+    tests.check(snapshot.restore(*lazyData, lazySkeleton, lazyAnimationState), "snapshot restores into lazily loaded data");
+    tests.check(lazyData->isAnimationLoaded(0) && lazyData->isAnimationLoaded(1), "restore loads the animations of the snapshot");
+
+    // a rotation count that doesn't match the animation would let spine-c write past the rotations
+    spTrackEntry* current = animationState->tracks[0];
+    int rotationCount = current->timelinesRotationCount;
+    float* rotations = current->timelinesRotation;
+    current->timelinesRotation = MALLOC(float, 2);
+    current->timelinesRotation[0] = current->timelinesRotation[1] = 0.0f;
+    current->timelinesRotationCount = 2;
+
+    spine::Snapshot corruptedSnapshot;
+    corruptedSnapshot.capture(*data, skeleton, animationState);
+
+    FREE(current->timelinesRotation);
+    current->timelinesRotation = rotations;
+    current->timelinesRotationCount = rotationCount;
+
+    tests.check(!corruptedSnapshot.restore(*data, restoredSkeleton, restoredAnimationState), "snapshot with wrong rotation count is rejected");
+
+    spAnimationState_clearTracks(lazyAnimationState);
+    lazyData->unloadAnimation(lazyData->getAnimation(0)->name);
+    lazyData->unloadAnimation(lazyData->getAnimation(1)->name);
+
+    tests.check(!corruptedSnapshot.restore(*lazyData, lazySkeleton, lazyAnimationState), "corrupted snapshot is rejected by lazily loaded data");
+    tests.check(!lazyData->isAnimationLoaded(0) && !lazyData->isAnimationLoaded(1), "rejected snapshot doesn't keep animations loaded");
+
+    // animations of other data have no index
+    spAnimationState_setAnimation(animationState, 1, lazyData->getAnimation(0), 1);
+    spine::Snapshot foreignSnapshot;
+    foreignSnapshot.capture(*data, skeleton, animationState);
+    spAnimationState_clearTrack(animationState, 1);
+
+    tests.check(!foreignSnapshot.restore(*data, restoredSkeleton, restoredAnimationState), "snapshot with unknown animation is rejected");
+
+    spAnimationState_dispose(restoredAnimationState);
+    spSkeleton_dispose(restoredSkeleton);
+    spAnimationState_dispose(lazyAnimationState);
+    spSkeleton_dispose(lazySkeleton);
+    spAnimationStateData_dispose(lazyAnimationStateData);
+    spAnimationState_dispose(animationState);
+    spSkeleton_dispose(skeleton);
+    spAnimationStateData_dispose(animationStateData);
+}
+
+static bool isSameGeometry(const spine::SpineDrawable& drawable, const spine::SpineDrawable& otherDrawable)
+{
+    const std::vector<graphics::Vertex>& vertices = drawable.getVertices();
+    const std::vector<graphics::Vertex>& otherVertices = otherDrawable.getVertices();
+
+    if (drawable.getIndices() != otherDrawable.getIndices() || vertices.size() != otherVertices.size()) return false;
+
+    for (size_t v = 0; v < vertices.size(); ++v)
+    {
+        if (!isNear(vertices[v].position.x, otherVertices[v].position.x) ||
+            !isNear(vertices[v].position.y, otherVertices[v].position.y) ||
+            vertices[v].texCoords[0].x != otherVertices[v].texCoords[0].x ||
+            vertices[v].texCoords[0].y != otherVertices[v].texCoords[0].y ||
+            vertices[v].color.r != otherVertices[v].color.r || vertices[v].color.g != otherVertices[v].color.g ||
+            vertices[v].color.b != otherVertices[v].color.b || vertices[v].color.a != otherVertices[v].color.a)
+            return false;
+    }
+
+    return true;
+}
+
+// a drawable drawn from a shared pose has to look like one that evaluated the pose itself
+static void testPoseSharing(SpineTests& tests)
+{
+    spine::SpineWorld world;
+    spine::SpineDrawable first(world, "spineboy.atlas", "spineboy.skel");
+    spine::SpineDrawable second(world, "spineboy.atlas", "spineboy.skel");
+    spine::SpineDrawable unshared(world, "spineboy.atlas", "spineboy.skel");
+
+    tests.check(first.isValid() && second.isValid() && unshared.isValid(), "spineboy loads for pose sharing");
+    if (!first.isValid() || !second.isValid() || !unshared.isValid()) return;
+
+    std::string animationName = first.getData()->getAnimation(0)->name;
+
+    first.setPoseSharing(true);
+    second.setPoseSharing(true);
+
+    for (spine::SpineDrawable* drawable : {&first, &second, &unshared})
+    {
+        drawable->setAnimation(0, animationName, true);
+        drawable->update(0.25f);
+        drawable->draw(Matrix4::IDENTITY, 1.0f, Matrix4::IDENTITY, false);
+    }
+
+    // the first drawable builds the pose in its own geometry before uploading it to the cache
+    tests.check(first.getStats().poseMisses == 1 && second.getStats().poseHits == 1, "second drawable reuses the pose of the first");
+    tests.check(isSameGeometry(first, unshared), "shared pose has the same geometry as an unshared draw");
+
+    const Box3& boundingBox = world.getBoundingBox(second.getHandle());
+    const Box3& unsharedBoundingBox = world.getBoundingBox(unshared.getHandle());
+    tests.check(isNear(boundingBox.min.x, unsharedBoundingBox.min.x) && isNear(boundingBox.min.y, unsharedBoundingBox.min.y) &&
+                isNear(boundingBox.max.x, unsharedBoundingBox.max.x) && isNear(boundingBox.max.y, unsharedBoundingBox.max.y),
+                "shared pose has the same bounding box as an unshared draw");
+
+    second.updateSkeleton();
+    const spine::SpineDrawable& constSecond = second;
+    const spine::SpineDrawable& constUnshared = unshared;
+    tests.check(isSamePose(constSecond.getSkeleton(), constUnshared.getSkeleton()), "updateSkeleton evaluates the shared pose");
+
+    // slot colors and attachments changed directly aren't part of the pose key
+    second.getSkeleton()->slots[0]->color.a = 0.5f;
+    second.update(0.0f);
+    second.draw(Matrix4::IDENTITY, 1.0f, Matrix4::IDENTITY, false);
+    tests.check(second.getStats().poseHits == 0 && second.getStats().poseMisses == 0, "directly changed drawable doesn't share poses");
+
+    second.reset();
+    second.update(0.0f);
+    second.draw(Matrix4::IDENTITY, 1.0f, Matrix4::IDENTITY, false);
+    tests.check(second.getStats().poseHits == 1, "reset drawable shares poses again");
+}
+
+// a handle kept after its drawable was destroyed must not refer to the drawable reusing its slot
+static void testWorldHandles(SpineTests& tests)
+{
+    spine::SpineWorld world;
+    std::unique_ptr<spine::SpineDrawable> drawable(new spine::SpineDrawable(world, "spineboy.atlas", "spineboy.skel"));
+
+    tests.check(drawable->isValid(), "spineboy loads for handles");
+    if (!drawable->isValid()) return;
+
+    spine::SpineWorld::Handle oldHandle = drawable->getHandle();
+    drawable.reset();
+    tests.check(!world.isValid(oldHandle), "destroyed handle is invalid");
+
+    drawable.reset(new spine::SpineDrawable(world, "spineboy.atlas", "spineboy.skel"));
+    spine::SpineWorld::Handle newHandle = drawable->getHandle();
+
+    tests.check((newHandle & spine::SpineWorld::HANDLE_SLOT_MASK) == (oldHandle & spine::SpineWorld::HANDLE_SLOT_MASK) &&
+                newHandle != oldHandle, "reused slot gets a new generation");
+    tests.check(world.isValid(newHandle) && !world.isValid(oldHandle), "stale handle doesn't refer to the reused slot");
+}
+
+static spSlot* findRegionSlot(spSkeleton* skeleton, const spSlot* skippedSlot)
+{
+    for (int i = 0; i < skeleton->slotsCount; ++i)
+    {
+        spSlot* slot = skeleton->drawOrder[i];
+        if (slot != skippedSlot && slot->attachment && slot->attachment->type == SP_ATTACHMENT_REGION) return slot;
+    }
+
+    return nullptr;
+}
+
+// slots that didn't change keep the vertices of earlier frames, so the result has to match a full rebuild
+// after colors, attachments and the draw order were changed
+static void testIncrementalGeometry(SpineTests& tests)
+{
+    spine::SpineWorld world;
+    spine::SpineDrawable incremental(world, "spineboy.atlas", "spineboy.skel");
+    spine::SpineDrawable full(world, "spineboy.atlas", "spineboy.skel");
+
+    tests.check(incremental.isValid() && full.isValid(), "spineboy loads for incremental geometry");
+    if (!incremental.isValid() || !full.isValid()) return;
+
+    std::string animationName = incremental.getData()->getAnimation(0)->name;
+    incremental.setAnimation(0, animationName, true);
+    full.setAnimation(0, animationName, true);
+
+    bool animationMatches = true;
+    bool colorsMatch = true;
+    bool attachmentsMatch = true;
+    bool drawOrderMatches = true;
+    uint32_t skippedSlotCount = 0;
+
+    for (int frame = 0; frame < 90; ++frame)
+    {
+        for (spine::SpineDrawable* drawable : {&incremental, &full})
+        {
+            spSkeleton* skeleton = drawable->getSkeleton();
+            spSlot* slot = findRegionSlot(skeleton, nullptr);
+            spSlot* otherSlot = slot ? findRegionSlot(skeleton, slot) : nullptr;
+
+            if (frame == 20 && slot)
+            {
+                slot->color.g = 0.5f;
+            }
+            else if (frame == 40 && slot && otherSlot)
+            {
+                spAttachment* attachment = slot->attachment;
+                spSlot_setAttachment(slot, otherSlot->attachment);
+                spSlot_setAttachment(otherSlot, attachment);
+            }
+            else if (frame == 50 && slot)
+            {
+                spSlot_setAttachment(slot, nullptr);
+            }
+            else if (frame == 60)
+            {
+                std::swap(skeleton->drawOrder[0], skeleton->drawOrder[skeleton->slotsCount - 1]);
+            }
+
+            drawable->update(1.0f / 30.0f);
+        }
+
+        full.invalidateGeometry();
+        incremental.draw(Matrix4::IDENTITY, 1.0f, Matrix4::IDENTITY, false);
+        full.draw(Matrix4::IDENTITY, 1.0f, Matrix4::IDENTITY, false);
+        skippedSlotCount += incremental.getStats().skippedSlotCount;
+
+        bool same = isSameGeometry(incremental, full);
+        if (frame < 20) animationMatches = animationMatches && same;
+        else if (frame < 40) colorsMatch = colorsMatch && same;
+        else if (frame < 60) attachmentsMatch = attachmentsMatch && same;
+        else drawOrderMatches = drawOrderMatches && same;
+    }
+
+    tests.check(skippedSlotCount > 0, "incremental rebuild skips unchanged slots");
+    tests.check(animationMatches, "incremental rebuild matches a full rebuild while the animation plays");
+    tests.check(colorsMatch, "incremental rebuild matches a full rebuild after color changes");
+    tests.check(attachmentsMatch, "incremental rebuild matches a full rebuild after attachment swaps");
+    tests.check(drawOrderMatches, "incremental rebuild matches a full rebuild after draw order changes");
+}
+
+static void appendUInt32(std::vector<uint8_t>& data, uint32_t value)
+{
+    data.push_back(static_cast<uint8_t>(value));
+    data.push_back(static_cast<uint8_t>(value >> 8));
+    data.push_back(static_cast<uint8_t>(value >> 16));
+    data.push_back(static_cast<uint8_t>(value >> 24));
+}
+
+// little endian KTX 1.1 file with one mip level
+static std::vector<uint8_t> createKTX(uint32_t internalFormat, uint32_t width, uint32_t height, const std::vector<uint8_t>& pixels)
+{
+    static const uint8_t IDENTIFIER[] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+    std::vector<uint8_t> data(IDENTIFIER, IDENTIFIER + sizeof(IDENTIFIER));
+    appendUInt32(data, 0x04030201); // endianness
+    appendUInt32(data, 0); // type
+    appendUInt32(data, 1); // type size
+    appendUInt32(data, 0); // format
+    appendUInt32(data, internalFormat);
+    appendUInt32(data, 0x1908); // base internal format
+    appendUInt32(data, width);
+    appendUInt32(data, height);
+    appendUInt32(data, 0); // depth
+    appendUInt32(data, 0); // array elements
+    appendUInt32(data, 1); // faces
+    appendUInt32(data, 1); // mip levels
+    appendUInt32(data, 0); // key and value bytes
+    appendUInt32(data, static_cast<uint32_t>(pixels.size()));
+    data.insert(data.end(), pixels.begin(), pixels.end());
+
+    return data;
+}
+
+static bool checkPixel(const spine::AtlasPageImage& image, uint32_t x, uint32_t y,
+                       uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+    if (x >= image.width || y >= image.height) return false;
+
+    const uint8_t* pixel = image.data.data() + (static_cast<size_t>(y) * image.width + x) * 4;
+    return pixel[0] == r && pixel[1] == g && pixel[2] == b && pixel[3] == a;
+}
+
+// single blocks for each ETC2 mode with pixels worked out from the Khronos data format specification
+static void testTextureDecoders(SpineTests& tests)
+{
+    static const uint32_t ETC1_RGB8 = 0x8D64;
+    static const uint32_t ETC2_RGB8 = 0x9274;
+    static const uint32_t ETC2_RGB8A1 = 0x9276;
+    static const uint32_t ETC2_RGBA8 = 0x9278;
+    static const uint32_t ASTC_4x4 = 0x93B0;
+
+    const std::vector<uint8_t> individualBlock = {0xA5, 0x3C, 0x00, 0x55, 0x80, 0x08, 0x80, 0x10};
+    const std::vector<uint8_t> tBlock = {0xF3, 0x2D, 0x48, 0xCB, 0x11, 0x00, 0x10, 0x10};
+    const std::vector<uint8_t> hBlock = {0x29, 0xEB, 0x54, 0x9E, 0x11, 0x00, 0x10, 0x10};
+    const std::vector<uint8_t> planarBlock = {0x00, 0x00, 0xEB, 0x7F, 0x00, 0x00, 0x00, 0x00};
+    const std::vector<uint8_t> punchthroughBlock = {0x80, 0x40, 0x00, 0x00, 0x11, 0x00, 0x10, 0x10};
+    const std::vector<uint8_t> alphaBlock = {0x80, 0x3D, 0xEE, 0x49, 0x24, 0x92, 0x49, 0x20};
+
+    spine::AtlasPageImage image;
+
+    tests.check(spine::decodeKTX(createKTX(ETC1_RGB8, 4, 4, individualBlock), image) &&
+                image.fileFormat == "ETC1" && image.width == 4 && image.height == 4 &&
+                checkPixel(image, 0, 0, 179, 60, 9, 255) &&
+                checkPixel(image, 1, 0, 199, 80, 29, 255) &&
+                checkPixel(image, 2, 1, 179, 60, 9, 255) &&
+                checkPixel(image, 0, 3, 61, 180, 0, 255) &&
+                checkPixel(image, 3, 3, 5, 124, 0, 255),
+                "ETC1 individual block decodes");
+
+    tests.check(spine::decodeKTX(createKTX(ETC2_RGB8, 4, 4, individualBlock), image) &&
+                image.fileFormat == "ETC2_RGB8" &&
+                checkPixel(image, 0, 0, 179, 60, 9, 255) &&
+                checkPixel(image, 3, 3, 5, 124, 0, 255),
+                "ETC2 individual block decodes like ETC1");
+
+    tests.check(spine::decodeKTX(createKTX(ETC2_RGB8, 4, 4, tBlock), image) &&
+                checkPixel(image, 0, 0, 187, 34, 221, 255) &&
+                checkPixel(image, 1, 0, 100, 168, 236, 255) &&
+                checkPixel(image, 2, 0, 68, 136, 204, 255) &&
+                checkPixel(image, 3, 0, 36, 104, 172, 255),
+                "ETC2 T mode block decodes");
+
+    tests.check(spine::decodeKTX(createKTX(ETC2_RGB8, 4, 4, hBlock), image) &&
+                checkPixel(image, 0, 0, 108, 57, 255, 255) &&
+                checkPixel(image, 1, 0, 62, 11, 215, 255) &&
+                checkPixel(image, 2, 0, 193, 176, 74, 255) &&
+                checkPixel(image, 3, 0, 147, 130, 28, 255),
+                "ETC2 H mode block decodes");
+
+    tests.check(spine::decodeKTX(createKTX(ETC2_RGB8, 4, 4, planarBlock), image) &&
+                checkPixel(image, 0, 0, 0, 0, 56, 255) &&
+                checkPixel(image, 1, 0, 64, 0, 42, 255) &&
+                checkPixel(image, 2, 0, 128, 0, 28, 255) &&
+                checkPixel(image, 3, 3, 191, 0, 0, 255),
+                "ETC2 planar block decodes");
+
+    tests.check(spine::decodeKTX(createKTX(ETC2_RGB8A1, 4, 4, punchthroughBlock), image) &&
+                image.fileFormat == "ETC2_RGB8A1" &&
+                checkPixel(image, 0, 0, 132, 66, 0, 255) &&
+                checkPixel(image, 1, 0, 140, 74, 8, 255) &&
+                checkPixel(image, 2, 0, 0, 0, 0, 0) &&
+                checkPixel(image, 3, 0, 124, 58, 0, 255),
+                "ETC2 punchthrough block decodes");
+
+    std::vector<uint8_t> rgbaBlock = alphaBlock;
+    rgbaBlock.insert(rgbaBlock.end(), individualBlock.begin(), individualBlock.end());
+
+    tests.check(spine::decodeKTX(createKTX(ETC2_RGBA8, 4, 4, rgbaBlock), image) &&
+                image.fileFormat == "ETC2_RGBA8" &&
+                checkPixel(image, 0, 0, 179, 60, 9, 155) &&
+                checkPixel(image, 1, 0, 199, 80, 29, 128) &&
+                checkPixel(image, 0, 1, 179, 60, 9, 98) &&
+                checkPixel(image, 3, 3, 5, 124, 0, 125),
+                "ETC2 block with EAC alpha decodes");
+
+    // blocks on the edges are cropped to the image
+    std::vector<uint8_t> edgeBlocks = individualBlock;
+    edgeBlocks.insert(edgeBlocks.end(), tBlock.begin(), tBlock.end());
+
+    tests.check(spine::decodeKTX(createKTX(ETC2_RGB8, 6, 3, edgeBlocks), image) &&
+                image.width == 6 && image.height == 3 && image.data.size() == 6 * 3 * 4 &&
+                checkPixel(image, 0, 0, 179, 60, 9, 255) &&
+                checkPixel(image, 5, 0, 100, 168, 236, 255),
+                "partial ETC2 blocks decode");
+
+    tests.check(!spine::decodeKTX(createKTX(ETC2_RGB8, 8, 8, individualBlock), image), "truncated ETC2 data is rejected");
+    tests.check(!spine::decodeKTX(createKTX(ASTC_4x4, 4, 4, std::vector<uint8_t>(16)), image), "ASTC is rejected");
+
+    std::vector<uint8_t> truncatedFile = createKTX(ETC2_RGB8, 4, 4, individualBlock);
+    truncatedFile.resize(truncatedFile.size() - 4);
+    tests.check(!spine::decodeKTX(truncatedFile, image), "truncated KTX file is rejected");
+
+    tests.check(spine::getTextureMemory(1024, 1024, graphics::PixelFormat::RGBA8_UNORM, false) == 4194304 &&
+                spine::getTextureMemory(1024, 1024, graphics::PixelFormat::RGBA8_UNORM, true) == 5592404 &&
+                spine::getTextureMemory(1024, 1024, graphics::PixelFormat::A8_UNORM, false) == 1048576,
+                "texture memory matches the pixel format and mip levels");
+}
+
+// convex polygon in either winding
+static bool isInsidePolygon(const std::vector<float>& polygon, float x, float y)
+{
+    size_t vertexCount = polygon.size() / 2;
+    bool negative = false;
+    bool positive = false;
+
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        size_t next = (i + 1) % vertexCount;
+        float cross = (polygon[next * 2] - polygon[i * 2]) * (y - polygon[i * 2 + 1]) -
+            (polygon[next * 2 + 1] - polygon[i * 2 + 1]) * (x - polygon[i * 2]);
+
+        if (cross < -0.001f) negative = true;
+        if (cross > 0.001f) positive = true;
+    }
+
+    return !(negative && positive);
+}
+
+static void testHulls(SpineTests& tests)
+{
+    // 32x32 region at 8, 4 of a 48x40 page with a disk of radius 12 in it
+    const uint32_t pageWidth = 48;
+    const uint32_t pageHeight = 40;
+    const int regionX = 8;
+    const int regionY = 4;
+    const int regionSize = 32;
+
+    std::vector<uint8_t> pixels(pageWidth * pageHeight * 4, 0);
+    uint32_t coveredCount = 0;
+
+    for (int y = 0; y < regionSize; ++y)
+    {
+        for (int x = 0; x < regionSize; ++x)
+        {
+            float distanceX = x + 0.5f - regionSize / 2.0f;
+            float distanceY = y + 0.5f - regionSize / 2.0f;
+
+            if (distanceX * distanceX + distanceY * distanceY <= 12.0f * 12.0f)
+            {
+                pixels[((regionY + y) * pageWidth + regionX + x) * 4 + 3] = 255;
+                ++coveredCount;
+            }
+        }
+    }
+
+    spine::HullSettings settings;
+    std::vector<float> hull = spine::computeHull(pixels.data(), pageWidth, regionX, regionY, regionSize, regionSize, settings);
+    float area = spine::getPolygonArea(hull);
+
+    tests.check(hull.size() >= 6 && hull.size() / 2 <= settings.maxVertices, "hull has at most the maximum number of vertices");
+    tests.check(area >= coveredCount && area <= regionSize * regionSize, "hull area is between the covered pixels and the region");
+
+    bool coversPixels = !hull.empty();
+    for (int y = 0; y < regionSize && coversPixels; ++y)
+    {
+        for (int x = 0; x < regionSize && coversPixels; ++x)
+        {
+            if (!pixels[((regionY + y) * pageWidth + regionX + x) * 4 + 3]) continue;
+
+            float left = static_cast<float>(regionX + x);
+            float top = static_cast<float>(regionY + y);
+            coversPixels = isInsidePolygon(hull, left, top) && isInsidePolygon(hull, left + 1.0f, top) &&
+                isInsidePolygon(hull, left, top + 1.0f) && isInsidePolygon(hull, left + 1.0f, top + 1.0f);
+        }
+    }
+
+    tests.check(coversPixels, "hull contains every covered pixel");
+
+    // the region left of the disk is transparent
+    tests.check(spine::computeHull(pixels.data(), pageWidth, 0, 0, 8, static_cast<int>(pageHeight), settings).empty(),
+                "transparent region has no hull");
+}
+
+SpineTests::SpineTests()
+{
+#if OUZEL_PLATFORM_LINUX
+    engine->getFileSystem().addResourcePath("Resources");
+#elif OUZEL_PLATFORM_WINDOWS
+    engine->getFileSystem().addResourcePath("Resources");
+#endif
+
+    testAnimationLoader(*this);
+    testSampler(*this);
+    testCompression(*this);
+    testSnapshots(*this);
+    testPoseSharing(*this);
+    testWorldHandles(*this);
+    testIncrementalGeometry(*this);
+    testTextureDecoders(*this);
+    testHulls(*this);
+
+    if (failureCount)
+        Log(Log::Level::ERR) << failureCount << " of " << checkCount << " checks failed";
+    else
+        Log(Log::Level::INFO) << "All " << checkCount << " checks passed";
+
+    engine->exit();
+}
+
+void SpineTests::check(bool condition, const std::string& message)
+{
+    ++checkCount;
+
+    if (!condition)
+    {
+        ++failureCount;
+        Log(Log::Level::ERR) << "Check failed: " << message;
+    }
+}
@@ -0,0 +1,22 @@
+// Copyright (C) 2017 Elviss Strazdins
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "SpineDrawable.hpp"
+
+// Runs deterministic checks of the spine module against the sample resources, logs every failure
+// and a summary and exits, started with the --test argument
+class SpineTests: public ouzel::Application
+{
+public:
+    SpineTests();
+
+    void check(bool condition, const std::string& message);
+    uint32_t getFailureCount() const { return failureCount; }
+
+private:
+    uint32_t checkCount = 0;
+    uint32_t failureCount = 0;
+};
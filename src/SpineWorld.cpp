@@ -0,0 +1,169 @@
+// Copyright (C) 2017 Elviss Strazdins
+
+#include "SpineWorld.hpp"
+#include "SpineDrawable.hpp"
+#include "spine/spine.h"
+#include "spine/extension.h"
+
+static void listener(spAnimationState* state, spEventType type, spTrackEntry* entry, spEvent* event)
+{
+    static_cast<spine::SpineDrawable*>(state->rendererObject)->handleEvent(type, entry, event);
+}
+
+namespace spine
+{
+    const SpineWorld::Handle SpineWorld::INVALID_HANDLE;
+    const uint32_t SpineWorld::HANDLE_SLOT_BITS;
+    const uint32_t SpineWorld::HANDLE_SLOT_MASK;
+
+    SpineWorld::SpineWorld()
+    {
+        updateHandler.updateHandler = std::bind(&SpineWorld::handleUpdate, this, std::placeholders::_1);
+        ouzel::engine->getEventDispatcher().addEventHandler(&updateHandler);
+    }
+
+    SpineWorld::~SpineWorld()
+    {
+        // drawables should be destroyed before the world, anything left is released here
+        while (!handles.empty())
+            destroy(handles.back());
+    }
+
+    SpineWorld::Handle SpineWorld::create(SpineDrawable* drawable, const std::string& atlasFile, const std::string& skeletonFile,
+                                          const LoadSettings& loadSettings)
+    {
+        std::shared_ptr<SpineData> instanceData = SpineData::load(atlasFile, skeletonFile, loadSettings);
+        if (!instanceData->isLoaded()) return INVALID_HANDLE;
+
+        uint32_t slot;
+
+        if (freeSlots.empty())
+        {
+            // the last slot is left out so that no handle equals INVALID_HANDLE
+            if (indices.size() >= HANDLE_SLOT_MASK)
+            {
+                ouzel::Log(ouzel::Log::Level::ERR) << "Too many spine instances";
+                return INVALID_HANDLE;
+            }
+
+            slot = static_cast<uint32_t>(indices.size());
+            indices.push_back(INVALID_HANDLE);
+            generations.push_back(0);
+        }
+        else
+        {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+
+        Handle handle = (generations[slot] << HANDLE_SLOT_BITS) | slot;
+        indices[slot] = static_cast<uint32_t>(handles.size());
+
+        spSkeletonData* skeletonData = instanceData->getSkeletonData();
+
+        spSkeleton* skeleton = spSkeleton_create(skeletonData);
+        spAnimationStateData* stateData = spAnimationStateData_create(skeletonData);
+
+        spAnimationState* animationState = spAnimationState_create(stateData);
+        animationState->listener = listener;
+        animationState->rendererObject = drawable;
+
+        spSkeleton_setToSetupPose(skeleton);
+        spSkeleton_updateWorldTransform(skeleton);
+
+        Stats instanceStats;
+        instanceStats.skeletonDataMemory = instanceData->getSkeletonDataMemory();
+        instanceStats.atlasPageMemory = instanceData->getAtlasPageMemory();
+
+        handles.push_back(handle);
+        drawables.push_back(drawable);
+        data.push_back(instanceData);
+        skeletons.push_back(skeleton);
+        animationStates.push_back(animationState);
+        animationStateData.push_back(stateData);
+        flags.push_back(0);
+        boundingBoxes.push_back(ouzel::Box3());
+        stats.push_back(instanceStats);
+        profilerIds.push_back(Profiler::getInstance().addDrawable(drawable));
+
+        return handle;
+    }
+
+    void SpineWorld::destroy(Handle handle)
+    {
+        if (!isValid(handle)) return;
+
+        uint32_t slot = handle & HANDLE_SLOT_MASK;
+        size_t index = indices[slot];
+        size_t last = handles.size() - 1;
+
+        Profiler::getInstance().removeDrawable(drawables[index]);
+
+        spAnimationState_dispose(animationStates[index]);
+        spAnimationStateData_dispose(animationStateData[index]);
+        spSkeleton_dispose(skeletons[index]);
+
+        if (index != last)
+        {
+            handles[index] = handles[last];
+            drawables[index] = drawables[last];
+            data[index] = std::move(data[last]);
+            skeletons[index] = skeletons[last];
+            animationStates[index] = animationStates[last];
+            animationStateData[index] = animationStateData[last];
+            flags[index] = flags[last];
+            boundingBoxes[index] = boundingBoxes[last];
+            stats[index] = stats[last];
+            profilerIds[index] = profilerIds[last];
+
+            indices[handles[index] & HANDLE_SLOT_MASK] = static_cast<uint32_t>(index);
+        }
+
+        handles.pop_back();
+        drawables.pop_back();
+        data.pop_back();
+        skeletons.pop_back();
+        animationStates.pop_back();
+        animationStateData.pop_back();
+        flags.pop_back();
+        boundingBoxes.pop_back();
+        stats.pop_back();
+        profilerIds.pop_back();
+
+        // handles of the destroyed instance stop being valid once the generation changes
+        indices[slot] = INVALID_HANDLE;
+        generations[slot] = (generations[slot] + 1) & (INVALID_HANDLE >> HANDLE_SLOT_BITS);
+        freeSlots.push_back(slot);
+    }
+
+    bool SpineWorld::handleUpdate(const ouzel::UpdateEvent& event)
+    {
+        update(event.delta);
+        return false;
+    }
+
+    void SpineWorld::update(float delta)
+    {
+        for (size_t i = 0; i < handles.size(); ++i)
+            updateInstance(i, delta);
+    }
+
+    void SpineWorld::update(Handle handle, float delta)
+    {
+        if (isValid(handle)) updateInstance(getIndex(handle), delta);
+    }
+
+    void SpineWorld::updateInstance(size_t index, float delta)
+    {
+        Stats& instanceStats = stats[index];
+        instanceStats.resetFrame();
+        instanceStats.skeletonDataMemory = data[index]->getSkeletonDataMemory();
+
+        if (flags[index] & PAUSED) return;
+
+        Profiler::Scope scope(instanceStats, Stats::UPDATE, profilerIds[index]);
+
+        spSkeleton_update(skeletons[index], delta);
+        spAnimationState_update(animationStates[index], delta);
+    }
+}
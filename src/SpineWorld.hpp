@@ -0,0 +1,101 @@
+// Copyright (C) 2017 Elviss Strazdins
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ouzel.hpp"
+#include "SpineData.hpp"
+#include "SpineProfiler.hpp"
+
+struct spSkeleton;
+struct spAnimationState;
+struct spAnimationStateData;
+
+namespace spine
+{
+    class SpineDrawable;
+
+    // Owns the animation state of all drawables created in it in parallel arrays walked by the update
+    // loop, the spine-c skeletons and animation states are still separate allocations that the arrays
+    // point to, while geometry, GPU buffers, materials and samplers stay in the drawables for drawing
+    class SpineWorld
+    {
+    public:
+        // the low bits of a handle select a slot and the high bits count how many times the slot was reused,
+        // so a handle kept after its instance was destroyed doesn't refer to the instance created in its place
+        typedef uint32_t Handle;
+        static const Handle INVALID_HANDLE = 0xFFFFFFFF;
+        static const uint32_t HANDLE_SLOT_BITS = 20;
+        static const uint32_t HANDLE_SLOT_MASK = (1 << HANDLE_SLOT_BITS) - 1;
+
+        enum Flags
+        {
+            POSE_SHARING = 0x01,
+            PAUSED = 0x02
+        };
+
+        SpineWorld();
+        ~SpineWorld();
+
+        SpineWorld(const SpineWorld&) = delete;
+        SpineWorld& operator=(const SpineWorld&) = delete;
+
+        // returns INVALID_HANDLE if the data failed to load or all slots are in use
+        Handle create(SpineDrawable* drawable, const std::string& atlasFile, const std::string& skeletonFile,
+                      const LoadSettings& loadSettings = LoadSettings());
+        void destroy(Handle handle);
+        bool isValid(Handle handle) const
+        {
+            uint32_t slot = handle & HANDLE_SLOT_MASK;
+            return slot < indices.size() && indices[slot] != INVALID_HANDLE && generations[slot] == (handle >> HANDLE_SLOT_BITS);
+        }
+
+        void update(float delta);
+        void update(Handle handle, float delta);
+
+        size_t getInstanceCount() const { return handles.size(); }
+
+        const std::shared_ptr<SpineData>& getData(Handle handle) const { return data[getIndex(handle)]; }
+        spSkeleton* getSkeleton(Handle handle) const { return skeletons[getIndex(handle)]; }
+        spAnimationState* getAnimationState(Handle handle) const { return animationStates[getIndex(handle)]; }
+        spAnimationStateData* getAnimationStateData(Handle handle) const { return animationStateData[getIndex(handle)]; }
+
+        uint32_t getFlags(Handle handle) const { return flags[getIndex(handle)]; }
+        void setFlags(Handle handle, uint32_t newFlags) { flags[getIndex(handle)] = newFlags; }
+
+        const ouzel::Box3& getBoundingBox(Handle handle) const { return boundingBoxes[getIndex(handle)]; }
+        void setBoundingBox(Handle handle, const ouzel::Box3& boundingBox) { boundingBoxes[getIndex(handle)] = boundingBox; }
+        // bounding boxes of all instances in storage order
+        const std::vector<ouzel::Box3>& getBoundingBoxes() const { return boundingBoxes; }
+
+        Stats& getStats(Handle handle) { return stats[getIndex(handle)]; }
+        const Stats& getStats(Handle handle) const { return stats[getIndex(handle)]; }
+        uint32_t getProfilerId(Handle handle) const { return profilerIds[getIndex(handle)]; }
+
+    private:
+        bool handleUpdate(const ouzel::UpdateEvent& event);
+        void updateInstance(size_t index, float delta);
+        uint32_t getIndex(Handle handle) const { return indices[handle & HANDLE_SLOT_MASK]; }
+
+        // handle slot to storage index, destroyed instances are replaced by the last one so the arrays stay packed
+        std::vector<uint32_t> indices;
+        std::vector<uint32_t> generations;
+        std::vector<uint32_t> freeSlots;
+
+        std::vector<Handle> handles;
+        std::vector<SpineDrawable*> drawables;
+        std::vector<std::shared_ptr<SpineData>> data;
+        std::vector<spSkeleton*> skeletons;
+        std::vector<spAnimationState*> animationStates;
+        std::vector<spAnimationStateData*> animationStateData;
+        std::vector<uint32_t> flags;
+        std::vector<ouzel::Box3> boundingBoxes;
+        std::vector<Stats> stats;
+        std::vector<uint32_t> profilerIds;
+
+        ouzel::EventHandler updateHandler;
+    };
+}
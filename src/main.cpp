@@ -1,8 +1,13 @@
 // Copyright (C) 2017 Elviss Strazdins
 
+#include <algorithm>
 #include "SpineSample.hpp"
+#include "SpineTests.hpp"
 
-std::unique_ptr<ouzel::Application> ouzel::main(const std::vector<std::string>&)
+std::unique_ptr<ouzel::Application> ouzel::main(const std::vector<std::string>& args)
 {
+    if (std::find(args.begin(), args.end(), "--test") != args.end())
+        return std::unique_ptr<Application>(new SpineTests());
+
     return std::unique_ptr<Application>(new SpineSample());
 }